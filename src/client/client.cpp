@@ -146,17 +146,17 @@ void Client::step(float dtime)
 		out.write(Packet2Server::PlaceBlock);
 
 		// Almost identical to the queue processing in Server::step()
-		for (auto it = queue.cbegin(); it != queue.cend(); ++it) {
+		for (; !queue.empty(); queue.pop_front()) {
+			const BlockUpdate &bu = queue.front();
 
 			out.write<u8>(true); // begin
 			// Write BlockUpdate
-			it->write(out);
+			bu.write(out);
 
 			DEBUGLOG("Client: sending block x=%d,y=%d,id=%d\n",
-				it->pos.X, it->pos.Y, it->getId());
+				bu.pos.X, bu.pos.Y, bu.getId());
 		}
 		out.write<u8>(false);
-		queue.clear();
 
 		m_con->send(0, 0, out);
 		break;
@@ -195,7 +195,12 @@ void Client::step(float dtime)
 	}
 
 	// Update tiles if triggered by Lua
-	if (world && world->modified_rect.isValid()) {
+	bool map_modified = false;
+	if (world) {
+		SimpleLock lock(world->mutex);
+		map_modified = !world->dirty.consume(DirtyMap::DC_EVENTS).empty();
+	}
+	if (map_modified) {
 		GameEvent e(GameEvent::C2G_MAP_UPDATE);
 		sendNewEvent(e);
 	}
@@ -265,6 +270,27 @@ bool Client::OnEvent(GameEvent &e)
 				Packet pkt;
 				pkt.write(Packet2Server::Join);
 				pkt.writeStr16(m_world_id);
+
+				RefCnt<World> cached;
+				if (m_protocol_version >= 12) {
+					SimpleLock lock(m_players_lock);
+					for (auto &world : m_world_cache) {
+						if (world->getMeta().id == m_world_id)
+							cached = world;
+					}
+				}
+				if (cached) {
+					// Only the modified chunks will be sent
+					SimpleLock lock(cached->mutex);
+					blockpos_t size = cached->getSize();
+					pkt.write(size.X);
+					pkt.write(size.Y);
+
+					auto hashes = cached->getChunkHashes();
+					pkt.write<u32>(hashes.size());
+					for (u64 hash : hashes)
+						pkt.write<u64>(hash);
+				}
 				m_con->send(0, 0, pkt);
 			}
 			return true;
@@ -410,7 +436,7 @@ bool Client::updateBlock(BlockUpdate bu)
 	if (!world->checkUpdateBlockNeeded(bu))
 		return false;
 
-	world->proc_queue.emplace(bu);
+	world->proc_queue.insert(bu);
 	return true;
 }
 
@@ -457,7 +483,7 @@ void Client::sendPlayerMove()
 
 	Packet pkt = createPacket(Packet2Server::Move);
 	player->step(0.0001f); // update controls
-	player->writePhysics(pkt);
+	player->writePhysics(pkt, player->updatePhysicsBaseline());
 	m_con->send(0, 1 | Connection::FLAG_UNRELIABLE, pkt);
 
 	player->last_sent_pos = player->last_pos;
@@ -495,6 +521,31 @@ void Client::onPeerDisconnected(peer_t)
 }
 
 void Client::processPacket(peer_t peer_id, Packet &pkt)
+{
+	handlePacket(peer_id, pkt, true);
+}
+
+bool Client::needsBulkData(Packet2Client action, const ClientPacketHandler &handler) const
+{
+	if (m_state != ClientState::WorldPlay) {
+		// Joining: the pending data creates the world
+		return (int)handler.min_player_state >= (int)ClientState::WorldJoin;
+	}
+
+	// Streamed or replaced world: only the block data must be complete
+	switch (action) {
+		case Packet2Client::WorldData:
+		case Packet2Client::WorldChunks:
+		case Packet2Client::PlaceBlock:
+		case Packet2Client::ActivateBlock:
+		case Packet2Client::ScriptEvent:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void Client::handlePacket(peer_t peer_id, Packet &pkt, bool may_hold)
 {
 	// one server instance, multiple worlds
 	int action = (int)pkt.read<Packet2Client>();
@@ -504,6 +555,12 @@ void Client::processPacket(peer_t peer_id, Packet &pkt)
 	}
 
 	const ClientPacketHandler &handler = packet_actions[action];
+	if (may_hold && isBulkPending() && needsBulkData((Packet2Client)action, handler)) {
+		// Depends on data that is yet to arrive on the bulk channel
+		m_bulk_held.emplace_back(pkt.data(), pkt.size());
+		return;
+	}
+
 	if ((int)handler.min_player_state > (int)m_state) {
 		logger(LL_ERROR, "not ready for action=%d", action);
 		return;
@@ -696,44 +753,44 @@ error:
 }
 
 
-uint8_t Client::getBlockTile(const Player *player, const Block *b)
+uint8_t Client::getBlockTile(const Player *player, blockpos_t pos, const Block &b)
 {
 	if (!m_bmgr->isHardcoded()) {
-		return m_tile_cache_mgr.getOrCache(b).tile;
+		return m_tile_cache_mgr.getOrCache(pos, b).tile;
 	}
 
 	auto world = player->getWorld();
 
-	auto get_params = [&world, b] () {
+	auto get_params = [&world, pos] () {
 		BlockParams params;
-		world->getParams(world->getBlockPos(b), &params);
+		world->getParams(pos, &params);
 		return params;
 	};
 
-	switch (b->id) {
+	switch (b.id) {
 		case Block::ID_SPIKES:
 			return get_params().param_u8;
 		case Block::ID_SECRET:
 		case Block::ID_BLACKFAKE:
-			if (uint8_t tile = b->tile)
+			if (uint8_t tile = b.tile)
 				return tile;
 			return player->godmode;
 		case Block::ID_TELEPORTER:
 			return get_params().teleporter.rotation;
 		case Block::ID_COIN:
 		case Block::ID_CHECKPOINT:
-			return b->tile;
+			return b.tile;
 		case Block::ID_COINDOOR:
 		case Block::ID_COINGATE:
 			return player->coins >= get_params().param_u8;
 		case Block::ID_DOOR_R:
 		case Block::ID_DOOR_G:
 		case Block::ID_DOOR_B:
-			return world->getMeta().keys[b->id - Block::ID_DOOR_R].isActive();
+			return world->getMeta().keys[b.id - Block::ID_DOOR_R].isActive();
 		case Block::ID_GATE_R:
 		case Block::ID_GATE_G:
 		case Block::ID_GATE_B:
-			return world->getMeta().keys[b->id - Block::ID_GATE_R].isActive();
+			return world->getMeta().keys[b.id - Block::ID_GATE_R].isActive();
 		case Block::ID_SWITCH:
 		case Block::ID_SWITCH_DOOR:
 		case Block::ID_SWITCH_GATE:
@@ -767,11 +824,12 @@ void Client::updateAllBlockTiles(bool reset_tiles)
 	m_tile_cache_mgr.removed_caches_counter = 0;
 
 	// Restore visuals to Block::tile after new world data
-	for (Block *b = world->begin(); b < world->end(); ++b) {
+	// Air chunks are not allocated and do not need any tile update.
+	world->forEachBlock([&] (blockpos_t pos, Block &b) {
 		if (reset_tiles)
-			b->tile = 0;
-		b->tile = getBlockTile(player, b);
-	}
+			b.tile = 0;
+		b.tile = getBlockTile(player, pos, b);
+	});
 	if (is_hardcoded || m_tile_cache_mgr.cache_miss_counter > 0) {
 		world->markAllModified();
 	}
@@ -790,6 +848,16 @@ void Client::quitToLobby(Player *p_to_keep)
 	// Keep myself in the list
 	if (p_to_keep) {
 		m_players.emplace(peer_ignored, p_to_keep);
+
+		if (auto world = p_to_keep->getWorld()) {
+			// Remember for a quick rejoin
+			m_world_cache.remove_if([&world] (const RefCnt<World> &w) {
+				return w == world || w->getMeta().id == world->getMeta().id;
+			});
+			m_world_cache.push_front(world);
+			if (m_world_cache.size() > WORLD_CACHE_MAX)
+				m_world_cache.pop_back();
+		}
 		p_to_keep->setWorld(nullptr);
 	}
 
@@ -7,6 +7,7 @@
 #include "core/world.h" // LobbyWorld
 #include "gameevent.h"
 #include "tilecache.h"
+#include <list>
 #include <string>
 
 class ClientMedia;
@@ -16,6 +17,7 @@ class LocalPlayer;
 class Player;
 
 struct ClientPacketHandler;
+enum class Packet2Client : uint16_t;
 enum class Packet2Server : uint16_t;
 
 // Similar to RemotePlayerState
@@ -83,12 +85,19 @@ public:
 	void onPeerDisconnected(peer_t peer_id) override;
 	void processPacket(peer_t peer_id, Packet &pkt) override;
 
+	// -------- For unittests
+	/// Skips the handshake and join request
+	void setStateForTest(ClientState state) { m_state = state; }
+	size_t getBulkHeldCount() const { return m_bulk_held.size(); }
+
 private:
+	/// may_hold: false for packets that are already in order (bulk payload)
+	void handlePacket(peer_t peer_id, Packet &pkt, bool may_hold);
 	void stepPhysics(float dtime);
 
 	void initScript();
 
-	uint8_t getBlockTile(const Player *player, const Block *b);
+	uint8_t getBlockTile(const Player *player, blockpos_t pos, const Block &b);
 
 public:
 	/// Updates all tiles
@@ -108,6 +117,10 @@ private:
 	void pkt_MediaReceive(Packet &pkt);
 	void pkt_Lobby(Packet &pkt);
 	void pkt_WorldData(Packet &pkt);
+	void pkt_WorldChunks(Packet &pkt);
+	void pkt_Bundle(Packet &pkt);
+	void pkt_Bulk(Packet &pkt);
+	void pkt_BulkBarrier(Packet &pkt);
 	void pkt_Join(Packet &pkt);
 	void pkt_Leave(Packet &pkt);
 	void pkt_SetPosition(Packet &pkt);
@@ -125,6 +138,15 @@ private:
 
 	static const ClientPacketHandler packet_actions[];
 
+	// Ordering across channels, see `Server::sendBulk`
+	/// Whether this packet must wait for a pending bulk packet. Others
+	/// (movement, chat, ...) are processed right away.
+	bool needsBulkData(Packet2Client action, const ClientPacketHandler &handler) const;
+	inline bool isBulkPending() const { return (s16)(m_bulk_seq_wait - m_bulk_seq_recv) > 0; }
+	u16 m_bulk_seq_recv = 0;
+	u16 m_bulk_seq_wait = 0;
+	std::list<Packet> m_bulk_held; // waiting for `m_bulk_seq_wait`
+
 	uint64_t m_time = 0,
 		m_time_prev = 0; // old time, before step() call
 
@@ -136,6 +158,9 @@ private:
 	uint16_t m_protocol_version = 0;
 
 	std::string m_world_id = "foobar";
+	/// Recently left worlds (front: newest) for delta updates upon rejoin
+	std::list<RefCnt<World>> m_world_cache;
+	static constexpr size_t WORLD_CACHE_MAX = 4;
 	ClientStartData m_start_data;
 	peer_t m_my_peer_id = 0;
 
@@ -41,6 +41,10 @@ const ClientPacketHandler Client::packet_actions[] = {
 	{ ClientState::Connected, &Client::pkt_MediaList },
 	{ ClientState::Connected, &Client::pkt_MediaReceive },
 	{ ClientState::WorldPlay, &Client::pkt_ScriptEvent }, // 20
+	{ ClientState::WorldJoin, &Client::pkt_WorldChunks },
+	{ ClientState::None,      &Client::pkt_Bundle },
+	{ ClientState::None,      &Client::pkt_Bulk },
+	{ ClientState::None,      &Client::pkt_BulkBarrier },
 	{ ClientState::Invalid, 0 }
 };
 
@@ -217,20 +221,45 @@ void Client::pkt_WorldData(Packet &pkt)
 	if (world_old) {
 		// Already joined
 		world = world_old;
+	} else if (mode == 3) {
+		// Delta to the cached copy
+		for (auto &cached : m_world_cache) {
+			if (cached->getMeta().id == m_world_id)
+				world = cached;
+		}
+		if (!world) {
+			// Evicted or never cached. Join again without hashes.
+			Packet out;
+			out.write(Packet2Server::Join);
+			out.writeStr16(m_world_id);
+			m_con->send(0, 0, out);
+			throw std::runtime_error("Cached world not found. Requested the full data.");
+		}
 	} else {
 		world = std::make_shared<World>(m_bmgr, m_world_id);
 	}
 
 	world->getMeta().readCommon(pkt);
 	world->getMeta().readSpecific(pkt);
-	blockpos_t size;
-	pkt.read<u16>(size.X);
-	pkt.read<u16>(size.Y);
-	world->createEmpty(size);
-	bool have_world_data = (mode == 1);
-	if (have_world_data) {
-		world->read(pkt);
-	} // else: clear
+	if (mode == 3) {
+		// Tiles are not part of the world data
+		world->forEachBlock([] (blockpos_t pos, Block &b) {
+			b.tile = 0;
+		});
+		world->readChunks(pkt);
+		world->markAllModified();
+	} else {
+		blockpos_t size;
+		pkt.read<u16>(size.X);
+		pkt.read<u16>(size.Y);
+		world->createEmpty(size);
+		if (mode == 1) {
+			world->read(pkt);
+		} else if (mode == 4) {
+			// Area around the spawn. More follows in `pkt_WorldChunks`.
+			world->readChunks(pkt);
+		} // else: clear
+	}
 
 	// World kept alive by at least one player (-> me)
 	for (auto &p : m_players)
@@ -251,6 +280,36 @@ void Client::pkt_WorldData(Packet &pkt)
 	DEBUGLOG("pkt_WorldData: done.\n");
 }
 
+void Client::pkt_WorldChunks(Packet &pkt)
+{
+	SimpleLock lock(m_players_lock);
+	LocalPlayer *player = getPlayerNoLock(m_my_peer_id);
+	auto world = player ? player->getWorld() : nullptr;
+	if (!world)
+		return; // left already
+
+	const bool is_last = pkt.read<u8>();
+	{
+		SimpleLock world_lock(world->mutex);
+		world->readChunks(pkt);
+	}
+
+	if (!is_last)
+		return;
+
+	DEBUGLOG("pkt_WorldChunks: done.\n");
+	{
+		SimpleLock world_lock(world->mutex);
+		player->updateCoinCount(true);
+	}
+	// Force update all, like upon join
+	m_tile_cache_mgr.removed_caches_counter = -1;
+	updateAllBlockTiles(false);
+
+	if (m_script)
+		m_script->onWorldData(world.get());
+}
+
 void Client::pkt_Join(Packet &pkt)
 {
 	SimpleLock lock(m_players_lock);
@@ -472,10 +531,11 @@ void Client::pkt_PlaceBlock(Packet &pkt)
 			(void)m_script->onBlockPlace(bu);
 		}
 
-		Block &b = world->updateBlockNoCheck(bu);
+		Block b = world->updateBlockNoCheck(bu);
 		if (!bu.isBackground()) {
-			m_tile_cache_mgr.clearCacheAt(&b);
-			b.tile = getBlockTile(player, &b);
+			m_tile_cache_mgr.clearCacheAt(bu.pos);
+			b.tile = getBlockTile(player, bu.pos, b);
+			world->setBlock(bu.pos, b);
 		}
 	}
 
@@ -571,15 +631,17 @@ void Client::pkt_ActivateBlock(Packet &pkt)
 			return; // unknown, unhandled block
 	};
 
-	// Quick iterate
+	// Quick iterate (indexed block IDs)
 	size_t n = 0;
 	auto world = player->getWorld();
-	for (Block *b = world->begin(); b < world->end(); ++b) {
-		bid_t id = b->id;
-		if (id == bid_door || id == bid_gate || id == bid_aux) {
-			b->tile = state;
-			n++;
-		}
+	for (bid_t id : { bid_door, bid_gate, bid_aux }) {
+		if (id == Block::ID_INVALID)
+			continue;
+
+		n += world->getBlocks(id, [state] (Block &b) {
+			b.tile = state;
+			return true;
+		}).size();
 	}
 
 	if (n > 0) {
@@ -682,6 +744,43 @@ void Client::pkt_WorldMeta(Packet &pkt)
 	sendNewEvent(e);
 }
 
+void Client::pkt_Bundle(Packet &pkt)
+{
+	// See Server::send
+	while (pkt.getRemainingBytes() > 0) {
+		const size_t len = pkt.read<u16>();
+		const uint8_t *data;
+		if (pkt.readRawNoCopy(&data, len) != len)
+			throw std::out_of_range("Bundle: truncated message");
+
+		Packet sub(data, len);
+		processPacket(0, sub); // server
+	}
+}
+
+void Client::pkt_Bulk(Packet &pkt)
+{
+	m_bulk_seq_recv = pkt.read<u16>();
+
+	const uint8_t *data;
+	size_t len = pkt.readRawNoCopy(&data, pkt.getRemainingBytes());
+	Packet inner(data, len);
+	// The bulk channel is ordered: a later barrier must not hold this one
+	handlePacket(0, inner, false); // server
+
+	// Release the packets that waited for this one
+	while (!m_bulk_held.empty() && !isBulkPending()) {
+		Packet held = std::move(m_bulk_held.front());
+		m_bulk_held.pop_front();
+		processPacket(0, held);
+	}
+}
+
+void Client::pkt_BulkBarrier(Packet &pkt)
+{
+	m_bulk_seq_wait = pkt.read<u16>();
+}
+
 void Client::pkt_Deprecated(Packet &pkt)
 {
 	logger(LL_WARN, "Ignoring deprecated packet %s", pkt.dump().c_str());
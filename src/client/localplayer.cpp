@@ -32,24 +32,16 @@ void LocalPlayer::updateCoinCount(bool force)
 		return;
 
 	int my_coins = coins; // move to stack
-	auto rect = m_world->modified_rect;
-	for (Block *b = m_world->begin(); b != m_world->end(); ++b) {
-		switch (b->id) {
-			case Block::ID_COINDOOR:
-			case Block::ID_COINGATE:
-			{
-				blockpos_t bp = m_world->getBlockPos(b);
-				BlockParams params;
-				m_world->getParams(bp, &params);
-				if (my_coins >= params.param_u8)
-					b->tile = 1;
-				else
-					b->tile = 0;
-				rect.addInternalPoint(bp);
-			}
-			break;
+	for (bid_t id : { Block::ID_COINDOOR, Block::ID_COINGATE }) {
+		// Indexed block IDs: no full world scan
+		Block b;
+		for (blockpos_t bp : m_world->getBlocks(id, nullptr)) {
+			BlockParams params;
+			m_world->getParams(bp, &params);
+			m_world->getBlock(bp, &b);
+			b.tile = my_coins >= params.param_u8;
+			m_world->setBlock(bp, b); // marks the area as modified
 		}
 	}
-	m_world->modified_rect = rect;
 }
 
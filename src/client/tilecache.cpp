@@ -31,7 +31,7 @@ void TileCacheManager::reset()
 	clearAll();
 }
 
-TileCacheEntry TileCacheManager::getOrCache(const Block *bptr)
+TileCacheEntry TileCacheManager::getOrCache(blockpos_t pos, const Block &b)
 {
 	/*
 		Performance measurements of a few non-string overlays
@@ -50,7 +50,6 @@ TileCacheEntry TileCacheManager::getOrCache(const Block *bptr)
 	*/
 	ASSERT_FORCED(m_script, "Missing init");
 
-	const Block b = *bptr;
 	auto props = m_bmgr->getProps(b.id);
 	if (!props || !props->haveGetVisuals())
 		return TileCacheEntry(b.tile, "");
@@ -60,7 +59,7 @@ TileCacheEntry TileCacheManager::getOrCache(const Block *bptr)
 	BlockParams params;
 
 	paramshash_t params_hash;
-	bool was_cached = getParamsHash(bptr, params, &params_hash);
+	bool was_cached = getParamsHash(pos, params, &params_hash);
 	const size_t hash = 0
 		| (size_t)(b.id)
 		| (size_t)(b.tile) << 16
@@ -78,7 +77,7 @@ TileCacheEntry TileCacheManager::getOrCache(const Block *bptr)
 
 	if (was_cached) {
 		// Needed for 'getVisuals'
-		m_world->getParams(m_world->getBlockPos(bptr), &params);
+		m_world->getParams(pos, &params);
 	}
 
 	// Add to cache
@@ -95,12 +94,12 @@ TileCacheEntry TileCacheManager::getOrCache(const Block *bptr)
 	return tce;
 }
 
-void TileCacheManager::clearCacheAt(const Block *b)
+void TileCacheManager::clearCacheAt(blockpos_t pos)
 {
 	if (m_params_hashes.empty())
 		return;
 
-	const size_t block_i = b - m_world->begin();
+	const size_t block_i = pos.Y * m_world->getSize().X + pos.X;
 	if (block_i < m_params_hashes.size()) {
 		m_params_hashes[block_i] = 0;
 	}
@@ -131,15 +130,14 @@ void TileCacheManager::clearCacheFor(bid_t block_id)
 }
 
 
-bool TileCacheManager::getParamsHash(const Block *b, BlockParams &params,
+bool TileCacheManager::getParamsHash(blockpos_t pos, BlockParams &params,
 	paramshash_t *hash_out)
 {
-	if (m_params_hashes.empty()) {
-		blockpos_t size = m_world->getSize();
+	const blockpos_t size = m_world->getSize();
+	if (m_params_hashes.empty())
 		m_params_hashes.resize(size.X * size.Y);
-	}
 
-	const size_t block_i = b - m_world->begin();
+	const size_t block_i = pos.Y * size.X + pos.X;
 
 	uint32_t params_hash = m_params_hashes[block_i];
 	if (params_hash != 0) {
@@ -150,7 +148,7 @@ bool TileCacheManager::getParamsHash(const Block *b, BlockParams &params,
 	this->params_hash_cache_eff--;
 
 	// Add to cache
-	m_world->getParams(m_world->getBlockPos(b), &params);
+	m_world->getParams(pos, &params);
 	if (params != BlockParams::Type::None) {
 		Packet pkt;
 		params.write(pkt);
@@ -159,8 +157,8 @@ bool TileCacheManager::getParamsHash(const Block *b, BlockParams &params,
 	params_hash += !params_hash; // make non-zero
 	m_params_hashes[block_i] = params_hash;
 
-	DEBUG_LOG("HASH PARAMS id=%d, tile=%d, hash=%X\n",
-		b->id, (int)b->tile, params_hash
+	DEBUG_LOG("HASH PARAMS x=%d, y=%d, hash=%X\n",
+		pos.X, pos.Y, params_hash
 	);
 
 	*hash_out = params_hash;
@@ -30,8 +30,8 @@ public:
 	void init(ClientScript *script, RefCnt<World> world);
 	void reset();
 
-	TileCacheEntry getOrCache(const Block *b);
-	void clearCacheAt(const Block *b);
+	TileCacheEntry getOrCache(blockpos_t pos, const Block &b);
+	void clearCacheAt(blockpos_t pos);
 	void clearCacheFor(bid_t block_id);
 	void clearAll() {
 		removed_caches_counter += m_cache.size();
@@ -52,7 +52,7 @@ public:
 private:
 	/// Intended to skip BlockParams hashing. size=(width * height)
 	std::vector<paramshash_t> m_params_hashes;
-	bool getParamsHash(const Block *b, BlockParams &params, paramshash_t *hash_out);
+	bool getParamsHash(blockpos_t pos, BlockParams &params, paramshash_t *hash_out);
 
 	ClientScript *m_script = nullptr;
 	const BlockManager *m_bmgr = nullptr;
@@ -75,17 +75,18 @@ static BP_STEP_CALLBACK(step_portal)
 	if (!world->getParams(pos, &src_bp))
 		return;
 
-	auto positions = world->getBlocks(Block::ID_TELEPORTER, [&] (const Block &b) {
-		blockpos_t dst_pos = world->getBlockPos(&b);
-		if (dst_pos == pos)
-			return false;
-
+	auto positions = world->getBlocks(Block::ID_TELEPORTER, nullptr);
+	for (auto it = positions.begin(); it != positions.end(); ) {
 		BlockParams dst_bp;
-		if (!world->getParams(dst_pos, &dst_bp))
-			return false;
-
-		return dst_bp.teleporter.id == src_bp.teleporter.dst_id;
-	});
+		bool ok = *it != pos
+			&& world->getParams(*it, &dst_bp)
+			&& dst_bp.teleporter.id == src_bp.teleporter.dst_id;
+
+		if (ok)
+			++it;
+		else
+			it = positions.erase(it);
+	}
 
 	if (positions.empty())
 		return;
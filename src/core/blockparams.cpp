@@ -63,10 +63,31 @@ BlockParams &BlockParams::operator=(const BlockParams &other)
 		set(other.m_type);
 	}
 
-	// Not very efficient but needs less code maintenance
-	Packet pkt;
-	other.write(pkt);
-	read(pkt);
+	if (m_type == Type::STR16) {
+		*text = *other.text;
+	} else {
+		// All other types are trivially copyable
+		param_u32 = other.param_u32;
+	}
+
+	return *this;
+}
+
+BlockParams::BlockParams(BlockParams &&other) :
+	m_type(Type::None)
+{
+	*this = std::move(other);
+}
+
+BlockParams &BlockParams::operator=(BlockParams &&other)
+{
+	if (this == &other)
+		return *this;
+
+	reset();
+	// Take over the ownership of heap-allocated data (if any)
+	memcpy((void *)this, (const void *)&other, sizeof(BlockParams));
+	other.m_type = Type::None;
 
 	return *this;
 }
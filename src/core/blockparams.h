@@ -32,6 +32,9 @@ struct BlockParams {
 	// Copy
 	BlockParams(const BlockParams &other);
 	BlockParams &operator=(const BlockParams &other);
+	// Move: `other` becomes Type::None
+	BlockParams(BlockParams &&other);
+	BlockParams &operator=(BlockParams &&other);
 
 	void read(Packet &pkt);
 	void write(Packet &pkt) const;
@@ -0,0 +1,117 @@
+#include "blockparamsmap.h"
+#include <algorithm> // std::max
+
+// Note: the maximal load factor is 3/4
+static constexpr size_t SLOTS_MIN = 16;
+
+const BlockParams *BlockParamsMap::find(blockpos_t pos) const
+{
+	if (m_entries.empty())
+		return nullptr;
+
+	const Slot &slot = m_slots[findSlot(pack(pos))];
+	if (!slot.index)
+		return nullptr;
+	return &m_entries[slot.index - 1].params;
+}
+
+BlockParams *BlockParamsMap::find(blockpos_t pos)
+{
+	return const_cast<BlockParams *>(((const BlockParamsMap *)this)->find(pos));
+}
+
+void BlockParamsMap::set(blockpos_t pos, BlockParams params)
+{
+	if ((m_entries.size() + 1) * 4 > m_slots.size() * 3)
+		rehash(std::max(SLOTS_MIN, m_slots.size() * 2));
+
+	const uint32_t key = pack(pos);
+	Slot &slot = m_slots[findSlot(key)];
+	if (slot.index) {
+		m_entries[slot.index - 1].params = std::move(params);
+		return;
+	}
+
+	m_entries.emplace_back(pos, std::move(params));
+	slot.key = key;
+	slot.index = m_entries.size();
+}
+
+bool BlockParamsMap::erase(blockpos_t pos)
+{
+	if (m_entries.empty())
+		return false;
+
+	size_t i = findSlot(pack(pos));
+	if (!m_slots[i].index)
+		return false;
+
+	const size_t removed = m_slots[i].index - 1;
+
+	// Backward shift deletion: keep the probe sequences intact
+	const size_t mask = m_slots.size() - 1;
+	for (size_t j = (i + 1) & mask; m_slots[j].index; j = (j + 1) & mask) {
+		const size_t home = getHome(m_slots[j].key);
+		// Keep the slot when `home` lies cyclically within (i, j]
+		const bool keep = (i < j)
+			? (home > i && home <= j)
+			: (home > i || home <= j);
+		if (keep)
+			continue;
+
+		m_slots[i] = m_slots[j];
+		i = j;
+	}
+	m_slots[i] = Slot();
+
+	// Fill the gap with the last entry
+	const size_t last = m_entries.size() - 1;
+	if (removed != last) {
+		m_entries[removed] = std::move(m_entries[last]);
+		m_slots[findSlot(pack(m_entries[removed].pos))].index = removed + 1;
+	}
+	m_entries.pop_back();
+	return true;
+}
+
+void BlockParamsMap::clear()
+{
+	m_entries.clear();
+	m_slots.clear();
+	m_shift = 32;
+}
+
+void BlockParamsMap::reserve(size_t n)
+{
+	m_entries.reserve(n);
+
+	size_t n_slots = SLOTS_MIN;
+	while (n * 4 > n_slots * 3)
+		n_slots *= 2;
+	if (n_slots > m_slots.size())
+		rehash(n_slots);
+}
+
+size_t BlockParamsMap::findSlot(uint32_t key) const
+{
+	const size_t mask = m_slots.size() - 1;
+	size_t i = getHome(key);
+	while (m_slots[i].index && m_slots[i].key != key)
+		i = (i + 1) & mask;
+	return i;
+}
+
+void BlockParamsMap::rehash(size_t n_slots)
+{
+	m_shift = 32;
+	for (size_t n = n_slots; n > 1; n >>= 1)
+		m_shift--;
+
+	m_slots.assign(n_slots, Slot());
+	for (size_t i = 0; i < m_entries.size(); ++i) {
+		const uint32_t key = pack(m_entries[i].pos);
+		Slot &slot = m_slots[findSlot(key)];
+		slot.key = key;
+		slot.index = i + 1;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "core/blockparams.h"
+#include "core/types.h" // blockpos_t
+#include <vector>
+
+/// Sparse position -> BlockParams storage with O(1) lookups.
+/// Entries are stored contiguously (unordered). The index uses open addressing
+/// with linear probing. Pointers to entries are invalidated by any modification.
+class BlockParamsMap {
+public:
+	struct Entry {
+		Entry(blockpos_t pos, BlockParams &&params) :
+			pos(pos), params(std::move(params)) {}
+
+		blockpos_t pos;
+		BlockParams params;
+	};
+
+	const BlockParams *find(blockpos_t pos) const;
+	BlockParams *find(blockpos_t pos);
+	/// Inserts or overwrites
+	void set(blockpos_t pos, BlockParams params);
+	/// Returns whether an entry was removed
+	bool erase(blockpos_t pos);
+	void clear();
+	void reserve(size_t n);
+
+	inline size_t size() const { return m_entries.size(); }
+	inline bool empty() const { return m_entries.empty(); }
+
+	// Contiguous iteration
+	std::vector<Entry>::const_iterator begin() const { return m_entries.begin(); }
+	std::vector<Entry>::const_iterator end() const { return m_entries.end(); }
+
+private:
+	struct Slot {
+		uint32_t key;
+		uint32_t index; // 0: unused, else index in m_entries + 1
+	};
+
+	static inline uint32_t pack(blockpos_t pos)
+	{
+		return (uint32_t)pos.Y << 16 | pos.X;
+	}
+	inline size_t getHome(uint32_t key) const
+	{
+		// Fibonacci hashing to spread neighbouring positions (upper bits)
+		return (uint32_t)(key * 0x9E3779B1U) >> m_shift;
+	}
+	/// Returns the slot that contains `key` or the free slot to use
+	size_t findSlot(uint32_t key) const;
+	void rehash(size_t n_slots);
+
+	std::vector<Entry> m_entries;
+	std::vector<Slot> m_slots; // size: power of two
+	uint8_t m_shift = 32; // 32 - log2(m_slots.size())
+};
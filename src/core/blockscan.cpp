@@ -0,0 +1,262 @@
+#include "blockscan.h"
+#include <cstring> // memcpy
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define BLOCKSCAN_X86
+	#include <immintrin.h>
+#endif
+
+/*
+	Packed Block representation (little-endian u32):
+		bits  0..11: foreground ID
+		bits 12..15: tile
+		bits 16..31: background ID
+*/
+static constexpr uint32_t MASK_ID = 0x0FFF;
+static constexpr uint32_t MASK_TILE = 0xF000;
+static constexpr int SHIFT_TILE = 12;
+
+static bool check_packed_layout()
+{
+	if (sizeof(Block) != sizeof(uint32_t))
+		return false; // e.g. MSVC
+
+	Block b;
+	b.id = 0xABC;
+	b.tile = 0x5;
+	b.bg = 0x1234;
+
+	uint32_t v;
+	memcpy(&v, &b, sizeof(v));
+	return v == 0x12345ABC;
+}
+
+static const bool s_packed_layout = check_packed_layout();
+
+// -------------- Scalar -------------
+
+static size_t find_id_scalar(const Block *blocks, size_t count, bid_t id, u16 *indices)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (blocks[i].id == id) {
+			if (indices)
+				indices[n] = i;
+			n++;
+		}
+	}
+	return n;
+}
+
+static size_t set_tile_scalar(Block *blocks, size_t count, bid_t id, uint8_t tile)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (blocks[i].id == id) {
+			blocks[i].tile = tile;
+			n++;
+		}
+	}
+	return n;
+}
+
+// -------------- SSE2 / AVX2 -------------
+
+#ifdef BLOCKSCAN_X86
+
+/// Appends the indices of the set bits
+static inline size_t append_bits(unsigned bits, size_t base, u16 *indices, size_t n)
+{
+	if (!indices)
+		return n + __builtin_popcount(bits);
+
+	while (bits) {
+		indices[n++] = base + __builtin_ctz(bits);
+		bits &= bits - 1;
+	}
+	return n;
+}
+
+__attribute__((target("sse2")))
+static size_t find_id_sse2(const Block *blocks, size_t count, bid_t id, u16 *indices)
+{
+	const __m128i v_mask = _mm_set1_epi32(MASK_ID);
+	const __m128i v_id = _mm_set1_epi32(id);
+
+	size_t n = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&blocks[i]);
+		__m128i eq = _mm_cmpeq_epi32(_mm_and_si128(v, v_mask), v_id);
+		unsigned bits = _mm_movemask_ps(_mm_castsi128_ps(eq));
+		if (bits)
+			n = append_bits(bits, i, indices, n);
+	}
+
+	for (; i < count; ++i) {
+		if (blocks[i].id == id) {
+			if (indices)
+				indices[n] = i;
+			n++;
+		}
+	}
+	return n;
+}
+
+__attribute__((target("sse2")))
+static size_t set_tile_sse2(Block *blocks, size_t count, bid_t id, uint8_t tile)
+{
+	const __m128i v_mask = _mm_set1_epi32(MASK_ID);
+	const __m128i v_id = _mm_set1_epi32(id);
+	const __m128i v_tile_mask = _mm_set1_epi32(MASK_TILE);
+	const __m128i v_tile = _mm_set1_epi32(((uint32_t)tile << SHIFT_TILE) & MASK_TILE);
+
+	size_t n = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i *ptr = (__m128i *)&blocks[i];
+		__m128i v = _mm_loadu_si128(ptr);
+		__m128i eq = _mm_cmpeq_epi32(_mm_and_si128(v, v_mask), v_id);
+		unsigned bits = _mm_movemask_ps(_mm_castsi128_ps(eq));
+		if (!bits)
+			continue;
+
+		// Replace the tile bits of the matching blocks
+		__m128i sel = _mm_and_si128(eq, v_tile_mask);
+		v = _mm_or_si128(_mm_andnot_si128(sel, v), _mm_and_si128(sel, v_tile));
+		_mm_storeu_si128(ptr, v);
+		n += __builtin_popcount(bits);
+	}
+
+	return n + set_tile_scalar(&blocks[i], count - i, id, tile);
+}
+
+__attribute__((target("avx2")))
+static size_t find_id_avx2(const Block *blocks, size_t count, bid_t id, u16 *indices)
+{
+	const __m256i v_mask = _mm256_set1_epi32(MASK_ID);
+	const __m256i v_id = _mm256_set1_epi32(id);
+
+	size_t n = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)&blocks[i]);
+		__m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(v, v_mask), v_id);
+		unsigned bits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+		if (bits)
+			n = append_bits(bits, i, indices, n);
+	}
+
+	for (; i < count; ++i) {
+		if (blocks[i].id == id) {
+			if (indices)
+				indices[n] = i;
+			n++;
+		}
+	}
+	return n;
+}
+
+__attribute__((target("avx2")))
+static size_t set_tile_avx2(Block *blocks, size_t count, bid_t id, uint8_t tile)
+{
+	const __m256i v_mask = _mm256_set1_epi32(MASK_ID);
+	const __m256i v_id = _mm256_set1_epi32(id);
+	const __m256i v_tile_mask = _mm256_set1_epi32(MASK_TILE);
+	const __m256i v_tile = _mm256_set1_epi32(((uint32_t)tile << SHIFT_TILE) & MASK_TILE);
+
+	size_t n = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i *ptr = (__m256i *)&blocks[i];
+		__m256i v = _mm256_loadu_si256(ptr);
+		__m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(v, v_mask), v_id);
+		unsigned bits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+		if (!bits)
+			continue;
+
+		// Replace the tile bits of the matching blocks
+		__m256i sel = _mm256_and_si256(eq, v_tile_mask);
+		v = _mm256_or_si256(_mm256_andnot_si256(sel, v), _mm256_and_si256(sel, v_tile));
+		_mm256_storeu_si256(ptr, v);
+		n += __builtin_popcount(bits);
+	}
+
+	return n + set_tile_scalar(&blocks[i], count - i, id, tile);
+}
+
+#endif // BLOCKSCAN_X86
+
+// -------------- Dispatcher -------------
+
+bool blockscan_supported(BlockScanImpl impl)
+{
+	switch (impl) {
+		case BlockScanImpl::Auto:
+		case BlockScanImpl::Scalar:
+			return true;
+#ifdef BLOCKSCAN_X86
+		case BlockScanImpl::SSE2:
+			return s_packed_layout && __builtin_cpu_supports("sse2");
+		case BlockScanImpl::AVX2:
+			return s_packed_layout && __builtin_cpu_supports("avx2");
+#else
+		default:
+			break;
+#endif
+	}
+	return false;
+}
+
+const char *blockscan_name(BlockScanImpl impl)
+{
+	switch (impl) {
+		case BlockScanImpl::Auto: return "Auto";
+		case BlockScanImpl::Scalar: return "Scalar";
+		case BlockScanImpl::SSE2: return "SSE2";
+		case BlockScanImpl::AVX2: return "AVX2";
+	}
+	return "??";
+}
+
+static BlockScanImpl resolve(BlockScanImpl impl)
+{
+	static const BlockScanImpl s_best =
+		blockscan_supported(BlockScanImpl::AVX2) ? BlockScanImpl::AVX2 :
+		blockscan_supported(BlockScanImpl::SSE2) ? BlockScanImpl::SSE2 :
+		BlockScanImpl::Scalar;
+
+	if (impl == BlockScanImpl::Auto || !blockscan_supported(impl))
+		return s_best;
+	return impl;
+}
+
+size_t blockscan_find_id(const Block *blocks, size_t count, bid_t id,
+	u16 *indices, BlockScanImpl impl)
+{
+	switch (resolve(impl)) {
+#ifdef BLOCKSCAN_X86
+		case BlockScanImpl::AVX2:
+			return find_id_avx2(blocks, count, id, indices);
+		case BlockScanImpl::SSE2:
+			return find_id_sse2(blocks, count, id, indices);
+#endif
+		default:
+			return find_id_scalar(blocks, count, id, indices);
+	}
+}
+
+size_t blockscan_set_tile(Block *blocks, size_t count, bid_t id, uint8_t tile,
+	BlockScanImpl impl)
+{
+	switch (resolve(impl)) {
+#ifdef BLOCKSCAN_X86
+		case BlockScanImpl::AVX2:
+			return set_tile_avx2(blocks, count, id, tile);
+		case BlockScanImpl::SSE2:
+			return set_tile_sse2(blocks, count, id, tile);
+#endif
+		default:
+			return set_tile_scalar(blocks, count, id, tile);
+	}
+}
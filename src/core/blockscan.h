@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.h" // Block
+
+/*
+	Vectorized kernels for scans over contiguous Block arrays (e.g. WorldChunk).
+	The SIMD variants require the 4-byte Block layout of GCC/Clang and are
+	selected at runtime. Otherwise the scalar fallback is used.
+*/
+
+enum class BlockScanImpl {
+	Auto, // fastest supported
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+/// Whether the implementation can be used on this machine
+bool blockscan_supported(BlockScanImpl impl);
+const char *blockscan_name(BlockScanImpl impl);
+
+/// Finds all blocks with the given foreground ID.
+/// @param indices Output buffer with `count` elements, may be nullptr
+/// @return Amount of matches
+size_t blockscan_find_id(const Block *blocks, size_t count, bid_t id,
+	u16 *indices, BlockScanImpl impl = BlockScanImpl::Auto);
+
+/// Sets the tile of all blocks with the given foreground ID.
+/// @return Amount of matches
+size_t blockscan_set_tile(Block *blocks, size_t count, bid_t id, uint8_t tile,
+	BlockScanImpl impl = BlockScanImpl::Auto);
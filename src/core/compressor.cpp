@@ -4,6 +4,7 @@
 #include <zlib.h>
 #include "logger.h"
 #include "packet.h"
+#include "threadpool.h"
 
 static Logger logger("Compressor", LL_WARN);
 
@@ -330,3 +331,29 @@ void Decompressor::decompress()
 	delete m_reader;
 	m_reader = nullptr;
 }
+
+void Decompressor::decompressParallel(std::vector<std::unique_ptr<Packet>> &outputs,
+	Packet &input, size_t limit)
+{
+	const size_t count = input.read<uint16_t>();
+
+	// Packet clones and reference counting are not thread-safe: prepare here.
+	std::vector<std::unique_ptr<Packet>> streams(count);
+	outputs.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		const size_t length = input.read<uint32_t>();
+		streams[i].reset(new Packet(&input)); // starts at the current position
+
+		const uint8_t *dummy;
+		if (input.readRawNoCopy(&dummy, length) != length)
+			throw std::runtime_error("decompressParallel: stream is truncated");
+
+		outputs[i].reset(new Packet());
+	}
+
+	ThreadPool::getShared().run(count, [&] (size_t i) {
+		Decompressor d(outputs[i].get(), *streams[i]);
+		d.setLimit(limit);
+		d.decompress();
+	});
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <memory> // unique_ptr
+#include <vector>
 
 struct DeflateReader;
 struct InflateWriter;
@@ -34,6 +36,12 @@ public:
 
 	void decompress();
 
+	/// Decompresses independent zlib streams in parallel.
+	/// Format: u16 count, then { u32 length, zlib stream } for each stream.
+	/// `limit`: maximal amount of decompressed bytes per stream
+	static void decompressParallel(std::vector<std::unique_ptr<Packet>> &outputs,
+		Packet &input, size_t limit);
+
 private:
 	DeflateReader *m_reader = nullptr;
 	Packet &m_output;
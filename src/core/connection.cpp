@@ -3,6 +3,7 @@
 #include "packet.h"
 
 #include <enet/enet.h>
+#include <algorithm> // std::min
 #include <iostream>
 #include <string.h> // strerror
 #include <sstream>
@@ -22,18 +23,22 @@
 		Player appearance
 		Chat commands (to be adopted)
 
+	2 - Bulk transfers (protocol version >= 16)
+		World data
+		Media
+		See `Server::sendBulk` for ordering dependencies on other channels.
+
 	Exception: when channel 1 packets hard-depend on world data
 	(channel 0), the relevant packets should be sent on channel 0 as well.
 */
 
 static Logger logger("ENet", LL_WARN);
 
-const uint16_t CON_PORT = 0xC014;
-const size_t CON_CLIENTS = 32; // server only
-const size_t CON_CHANNELS = 2;
+const uint16_t CON_PORT = Connection::PORT_DEFAULT;
+const size_t CON_CHANNELS = 3;
 
 // Globally accessible values
-const uint16_t PROTOCOL_VERSION_MAX = 10;
+const uint16_t PROTOCOL_VERSION_MAX = 16;
 const uint16_t PROTOCOL_VERSION_MIN = 7;
 // Note: ENet already splits up packets into fragments, thus manual splitting
 // for low data volumes should not be necessary.
@@ -54,7 +59,7 @@ static struct enet_init {
 	}
 } ENET_INIT;
 
-Connection::Connection(Connection::ConnectionType type, const char *name)
+Connection::Connection(Connection::ConnectionType type, const char *name, size_t max_peers)
 {
 	if (name)
 		m_name = name;
@@ -75,13 +80,18 @@ Connection::Connection(Connection::ConnectionType type, const char *name)
 		address.host = ENET_HOST_ANY;
 		address.port = CON_PORT;
 
-		logger(LL_PRINT, "%s: Starting server on port %d\n", m_name, address.port);
+		if (max_peers == 0)
+			max_peers = MAX_PEERS_DEFAULT;
+		max_peers = std::min<size_t>(max_peers, ENET_PROTOCOL_MAXIMUM_PEER_ID);
+
+		logger(LL_PRINT, "%s: Starting server on port %d for %zu peers\n",
+			m_name, address.port, max_peers);
 		m_host = enet_host_create(
 			&address,
-			CON_CLIENTS,
+			max_peers,
 			CON_CHANNELS,
-			10 * CON_CLIENTS * 1024, // incoming bandwidth [bytes/s]
-			50 * CON_CLIENTS * 1024 // outgoing bandwidth [bytes/s]
+			10 * max_peers * 1024, // incoming bandwidth [bytes/s]
+			50 * max_peers * 1024 // outgoing bandwidth [bytes/s]
 		);
 	}
 
@@ -96,9 +106,12 @@ Connection::~Connection()
 	if (!m_host)
 		return;
 
-	for (size_t i = 0; i < m_host->peerCount; ++i)
-		enet_peer_disconnect_later(&m_host->peers[i], 0);
-	enet_host_flush(m_host);
+	{
+		SimpleLock lock(m_host_lock);
+		for (size_t i = 0; i < m_host->peerCount; ++i)
+			enet_peer_disconnect_later(&m_host->peers[i], 0);
+		enet_host_flush(m_host);
+	}
 
 	if (m_thread) {
 		m_thread->join();
@@ -121,7 +134,8 @@ bool Connection::connect(const char *hostname)
 	enet_address_set_host(&address, hostname);
 	address.port = CON_PORT;
 
-	ENetPeer *peer = enet_host_connect(m_host, &address, 2, 0);
+	SimpleLock lock(m_host_lock);
+	ENetPeer *peer = enet_host_connect(m_host, &address, CON_CHANNELS, 0);
 	if (!peer) {
 		logger(LL_ERROR, "%s: No free peers\n", m_name);
 		return false;
@@ -136,6 +150,7 @@ bool Connection::connect(const char *hostname)
 
 void Connection::flush()
 {
+	SimpleLock lock(m_host_lock);
 	enet_host_flush(m_host);
 }
 
@@ -144,11 +159,12 @@ size_t Connection::getPeerIDs(std::vector<peer_t> *fill) const
 	if (fill)
 		fill->clear();
 
+	SimpleLock lock(m_peers_lock);
 	size_t count = 0;
-	for (size_t i = 0; i < m_host->peerCount; ++i) {
-		if (m_host->peers[i].state == ENET_PEER_STATE_CONNECTED) {
+	for (auto &it : m_peers) {
+		if (it.second->state == ENET_PEER_STATE_CONNECTED) {
 			if (fill)
-				fill->push_back(m_host->peers[i].connectID);
+				fill->push_back(it.first);
 			count++;
 		}
 	}
@@ -174,6 +190,7 @@ void Connection::disconnect(peer_t peer_id)
 	if (!peer)
 		return;
 
+	SimpleLock lock(m_host_lock);
 	enet_peer_disconnect_later(peer, 0);
 	// Actual handling done in async event handler
 }
@@ -210,6 +227,15 @@ uint32_t Connection::getPeerBytesInTransit(peer_t peer_id)
 	return peer->reliableDataInTransit;
 }
 
+uint32_t Connection::getPeerSendWindow(peer_t peer_id)
+{
+	auto peer = findPeer(peer_id);
+	if (!peer || peer->reliableDataInTransit >= peer->windowSize)
+		return 0;
+
+	return peer->windowSize - peer->reliableDataInTransit;
+}
+
 std::string Connection::getDebugInfo(peer_t peer_id) const
 {
 	auto peer = findPeer(peer_id);
@@ -258,6 +284,10 @@ void Connection::send(peer_t peer_id, uint16_t flags, Packet &pkt)
 		if (!peer)
 			return;
 
+		// Older clients connect with fewer channels
+		if (channel >= peer->channelCount)
+			channel = 0;
+
 		peer_id = peer->connectID;
 		enet_peer_send(peer, channel, epkt);
 	}
@@ -282,24 +312,51 @@ void Connection::recvAsyncInternal()
 	int shutdown_seen = 0;
 	ENetEvent event;
 
-	std::vector<peer_t> peer_id_list(m_host->peerCount, 0);
-
-	// TODO: Perhaps move async back to sync. This enet stuff is not thread-safe
+	// Indexed by ENetPeer. Caches values that are reset on disconnect.
+	struct PeerInfo {
+		peer_t peer_id = 0;
+		uint32_t mtu = 0;
+	};
+	std::vector<PeerInfo> peer_info(m_host->peerCount);
+
+	auto update_mtu = [this] () {
+		// m_peer_mtus is sorted: lowest first
+		size_t new_mtu = ENET_PROTOCOL_MAXIMUM_MTU;
+		if (!m_peer_mtus.empty())
+			new_mtu = std::min<size_t>(new_mtu, *m_peer_mtus.begin());
+
+		CONNECTION_MTU = new_mtu - 200;
+	};
+	update_mtu();
+
+	// ENet is not thread-safe: every call on the host must hold m_host_lock.
+	// `send` and `flush` run on other threads.
 	while (true) {
 		if (!m_running && shutdown_seen == 0) {
 			shutdown_seen++;
 			logger(LL_DEBUG, "%s: Shutdown requested\n", m_name);
 
 			// Lazy disconnect
+			SimpleLock lock(m_host_lock);
 			for (size_t i = 0; i < m_host->peerCount; ++i)
 				enet_peer_disconnect_later(&m_host->peers[i], 0);
 		}
 
-		int status = enet_host_service(m_host, &event, 100);
+		int status;
+		{
+			SimpleLock lock(m_host_lock);
+			status = enet_host_service(m_host, &event, 0);
+		}
 		if (status < 0) {
 			logger(LL_ERROR, "%s: Got host error code %d\n", m_name, status);
 		}
 		if (status <= 0) {
+			// Wait outside of the lock to not block `send` and `flush`
+			enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+			if (enet_socket_wait(m_host->socket, &condition, 100) == 0
+					&& (condition & ENET_SOCKET_WAIT_RECEIVE))
+				continue;
+
 			// Abort after 500 ms
 			if (shutdown_seen > 0) {
 				if (++shutdown_seen > 5)
@@ -308,29 +365,23 @@ void Connection::recvAsyncInternal()
 			continue;
 		}
 
-		{
-			// Update MTU
-			size_t new_mtu = ENET_PROTOCOL_MAXIMUM_MTU;
-			for (size_t i = 0; i < m_host->peerCount; ++i) {
-				auto &peer = m_host->peers[i];
-				if (peer.state != ENET_PEER_STATE_CONNECTED)
-					continue;
-
-				if (peer.mtu && peer.mtu < new_mtu) {
-					new_mtu = peer.mtu;
-				}
-			}
-
-			CONNECTION_MTU = new_mtu - 200;
-		}
-
 		switch (event.type) {
 			case ENET_EVENT_TYPE_CONNECT:
 				{
 					peer_t peer_id = event.peer->connectID;
+					PeerInfo &info = peer_info[event.peer - m_host->peers];
+					info.peer_id = peer_id;
+					info.mtu = event.peer->mtu;
+					{
+						SimpleLock lock(m_peers_lock);
+						m_peers[peer_id] = event.peer;
+						if (info.mtu)
+							m_peer_mtus.insert(info.mtu);
+						update_mtu();
+					}
+
 					std::string address = getPeerAddress(peer_id);
 					logger(LL_DEBUG, "%s: New peer ID %u from %s\n", m_name, peer_id, address.c_str());
-					peer_id_list[event.peer - m_host->peers] = peer_id;
 					m_processor->onPeerConnected(peer_id);
 				}
 				break;
@@ -355,7 +406,18 @@ void Connection::recvAsyncInternal()
 			case ENET_EVENT_TYPE_DISCONNECT:
 				{
 					// event.peer->connectID is always 0. Need to cache it.
-					peer_t peer_id = peer_id_list.at(event.peer - m_host->peers);
+					PeerInfo &info = peer_info.at(event.peer - m_host->peers);
+					peer_t peer_id = info.peer_id;
+					{
+						SimpleLock lock(m_peers_lock);
+						m_peers.erase(peer_id);
+						auto it = m_peer_mtus.find(info.mtu);
+						if (it != m_peer_mtus.end())
+							m_peer_mtus.erase(it);
+						update_mtu();
+					}
+					info = PeerInfo();
+
 					logger(LL_DEBUG, "%s: Peer %u disconnected\n", m_name, peer_id);
 					m_processor->onPeerDisconnected(peer_id);
 				}
@@ -369,17 +431,22 @@ void Connection::recvAsyncInternal()
 
 _ENetPeer *Connection::findPeer(peer_t peer_id) const
 {
-	// m_host->peers is a simple array. Thread locks are not important.
+	SimpleLock lock(m_peers_lock);
 
-	for (size_t i = 0; i < m_host->peerCount; ++i) {
-		if (m_host->peers[i].state != ENET_PEER_STATE_CONNECTED)
-			continue;
-
-		peer_t current = m_host->peers[i].connectID;
-		if (current == peer_id || peer_id == PEER_ID_FIRST)
-			return &m_host->peers[i];
+	ENetPeer *peer = nullptr;
+	if (peer_id == PEER_ID_FIRST) {
+		// Client: the server
+		if (!m_peers.empty())
+			peer = m_peers.begin()->second;
+	} else {
+		auto it = m_peers.find(peer_id);
+		if (it != m_peers.end())
+			peer = it->second;
 	}
 
-	return nullptr;
+	// e.g. lazy disconnect in progress
+	if (peer && peer->state != ENET_PEER_STATE_CONNECTED)
+		return nullptr;
+	return peer;
 }
 
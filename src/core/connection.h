@@ -2,6 +2,8 @@
 
 #include "macros.h"
 #include <cstdint>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 extern const uint16_t PROTOCOL_VERSION_MAX;
@@ -24,13 +26,15 @@ public:
 		TYPE_SERVER
 	};
 
-	Connection(ConnectionType type, const char *name);
+	/// @param max_peers Server only. 0: default
+	Connection(ConnectionType type, const char *name, size_t max_peers = 0);
 	~Connection();
 	DISABLE_COPY(Connection)
 
 	bool connect(const char *hostname);
 
-	void flush(); // for debugging
+	/// Sends the queued packets immediately
+	void flush();
 	size_t getPeerIDs(std::vector<peer_t> *fill) const;
 
 	bool listenAsync(PacketProcessor &proc);
@@ -38,12 +42,16 @@ public:
 	std::string getPeerAddress(peer_t peer_id);
 	float getPeerRTT(peer_t peer_id);
 	uint32_t getPeerBytesInTransit(peer_t peer_id);
+	/// Bytes that can be sent until the congestion window is full
+	uint32_t getPeerSendWindow(peer_t peer_id);
 
 	/// Main purpose: client-sided information display
 	std::string getDebugInfo(peer_t peer_id) const;
 
 	// use only on single connections
 	static const peer_t PEER_ID_FIRST = 0;
+	static const size_t MAX_PEERS_DEFAULT = 32;
+	static const uint16_t PORT_DEFAULT = 0xC014;
 	enum PacketFlags {
 		FLAG_MASK_CHANNEL = 0x00FF, // internal
 		FLAG_BROADCAST = 0x0100,
@@ -64,6 +72,11 @@ private:
 	std::mutex m_host_lock;
 	_ENetHost *m_host = nullptr;
 
+	/// Connected peers, updated by the receive thread
+	mutable std::mutex m_peers_lock;
+	std::unordered_map<peer_t, _ENetPeer *> m_peers;
+	std::multiset<uint32_t> m_peer_mtus; // for CONNECTION_MTU
+
 	PacketProcessor *m_processor = nullptr;
 };
 
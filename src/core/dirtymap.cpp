@@ -0,0 +1,104 @@
+#include "dirtymap.h"
+#include <algorithm> // std::min
+#include <map>
+
+static constexpr u16 TILE_MASK = (1 << DirtyMap::TILE_LOG2) - 1;
+
+void DirtyMap::resize(blockpos_t size)
+{
+	m_size = size;
+	m_tiles_size.X = (size.X + TILE_MASK) >> TILE_LOG2;
+	m_tiles_size.Y = (size.Y + TILE_MASK) >> TILE_LOG2;
+
+	m_bits.assign((size_t)m_tiles_size.X * m_tiles_size.Y, 0);
+	for (size_t &count : m_count)
+		count = 0;
+	markAll();
+}
+
+void DirtyMap::markTile(size_t index)
+{
+	u8 &bits = m_bits[index];
+	if (bits == BITS_ALL)
+		return;
+
+	for (int c = 0; c < DC_MAX; ++c)
+		m_count[c] += !(bits & (1 << c));
+	bits = BITS_ALL;
+}
+
+void DirtyMap::mark(blockpos_t pos)
+{
+	if (pos.X >= m_size.X || pos.Y >= m_size.Y)
+		return;
+
+	markTile((size_t)(pos.Y >> TILE_LOG2) * m_tiles_size.X + (pos.X >> TILE_LOG2));
+}
+
+void DirtyMap::mark(const core::rect<u16> &area)
+{
+	if (m_bits.empty() || !area.isValid())
+		return;
+
+	const u16 x1 = std::min<u16>(area.LowerRightCorner.X, m_size.X - 1) >> TILE_LOG2;
+	const u16 y1 = std::min<u16>(area.LowerRightCorner.Y, m_size.Y - 1) >> TILE_LOG2;
+	for (u16 y = area.UpperLeftCorner.Y >> TILE_LOG2; y <= y1; ++y)
+	for (u16 x = area.UpperLeftCorner.X >> TILE_LOG2; x <= x1; ++x)
+		markTile((size_t)y * m_tiles_size.X + x);
+}
+
+void DirtyMap::markAll()
+{
+	std::fill(m_bits.begin(), m_bits.end(), BITS_ALL);
+	for (size_t &count : m_count)
+		count = m_bits.size();
+}
+
+std::vector<core::rect<u16>> DirtyMap::consume(Consumer c)
+{
+	std::vector<core::rect<u16>> areas;
+	if (m_count[c] == 0)
+		return areas;
+
+	const u8 bit = 1 << c;
+	// Key: (x_start << 16 | x_end) of the runs in the previous row
+	std::map<u32, size_t> open, open_next;
+
+	for (u16 ty = 0; ty < m_tiles_size.Y; ++ty) {
+		u8 *row = &m_bits[(size_t)ty * m_tiles_size.X];
+		const u16 y0 = ty << TILE_LOG2;
+		const u16 y1 = std::min<int>(y0 + TILE_MASK, m_size.Y - 1);
+
+		for (u16 tx = 0; tx < m_tiles_size.X; ) {
+			if (!(row[tx] & bit)) {
+				tx++;
+				continue;
+			}
+
+			// Horizontal run of dirty tiles
+			const u16 run_start = tx;
+			for (; tx < m_tiles_size.X && (row[tx] & bit); ++tx)
+				row[tx] &= ~bit;
+
+			const u16 x0 = run_start << TILE_LOG2;
+			const u16 x1 = std::min<int>((tx << TILE_LOG2) - 1, m_size.X - 1);
+			const u32 key = (u32)x0 << 16 | x1;
+
+			// Extend the area of the row above if it spans equally
+			auto it = open.find(key);
+			if (it != open.end()) {
+				areas[it->second].LowerRightCorner.Y = y1;
+				open_next.emplace(key, it->second);
+			} else {
+				areas.emplace_back(x0, y0, x1, y1);
+				open_next.emplace(key, areas.size() - 1);
+			}
+		}
+
+		open.swap(open_next);
+		open_next.clear();
+	}
+
+	m_count[c] = 0;
+	return areas;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h" // blockpos_t
+#include <rect.h>
+#include <vector>
+
+/// Coarse tracking of modified world areas. Each consumer (bit) is
+/// cleared independently, thus only receives the areas changed since
+/// its last `consume` call. Not thread-safe: guard with `World::mutex`.
+class DirtyMap {
+public:
+	enum Consumer : u8 {
+		DC_RENDER,  // SceneWorldRender
+		DC_MINIMAP, // SceneMinimap
+		DC_EVENTS,  // Client: C2G_MAP_UPDATE notifications
+		DC_MAX
+	};
+
+	static constexpr u16 TILE_LOG2 = 4; // 16x16 blocks
+
+	/// Resets the map. All tiles are marked.
+	void resize(blockpos_t size);
+
+	void mark(blockpos_t pos);
+	/// Corners are inclusive
+	void mark(const core::rect<u16> &area);
+	void markAll();
+
+	inline bool isDirty(Consumer c) const { return m_count[c] > 0; }
+	/// Returns the modified areas (inclusive corners, within the world)
+	/// and clears them for this consumer.
+	std::vector<core::rect<u16>> consume(Consumer c);
+
+private:
+	static constexpr u8 BITS_ALL = (1 << DC_MAX) - 1;
+
+	void markTile(size_t index);
+
+	blockpos_t m_size; // in blocks
+	blockpos_t m_tiles_size;
+	std::vector<u8> m_bits; // bit N: dirty for consumer N
+	size_t m_count[DC_MAX] = {}; // amount of dirty tiles
+};
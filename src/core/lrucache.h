@@ -0,0 +1,78 @@
+#pragma once
+
+#include "macros.h"
+#include <list>
+#include <unordered_map>
+
+/// Key-value map that evicts the least recently used entry once `capacity`
+/// is exceeded. Counts the lookups for tuning purposes. Not thread-safe.
+template<typename K, typename V>
+class LRUCache {
+public:
+	LRUCache(size_t capacity) :
+		m_capacity(capacity) {}
+
+	DISABLE_COPY(LRUCache)
+
+	/// Returns nullptr if not cached. Marks the entry as recently used.
+	V *get(const K &key)
+	{
+		auto it = m_map.find(key);
+		if (it == m_map.end()) {
+			misses++;
+			return nullptr;
+		}
+
+		hits++;
+		m_list.splice(m_list.begin(), m_list, it->second);
+		return &it->second->second;
+	}
+
+	/// Inserts or overwrites an entry
+	V *set(const K &key, V value)
+	{
+		auto it = m_map.find(key);
+		if (it != m_map.end()) {
+			m_list.splice(m_list.begin(), m_list, it->second);
+			it->second->second = std::move(value);
+			return &it->second->second;
+		}
+
+		m_list.emplace_front(key, std::move(value));
+		m_map.emplace(key, m_list.begin());
+
+		if (m_list.size() > m_capacity) {
+			m_map.erase(m_list.back().first);
+			m_list.pop_back();
+		}
+		return &m_list.front().second;
+	}
+
+	void erase(const K &key)
+	{
+		auto it = m_map.find(key);
+		if (it == m_map.end())
+			return;
+
+		m_list.erase(it->second);
+		m_map.erase(it);
+	}
+
+	void clear()
+	{
+		m_map.clear();
+		m_list.clear();
+	}
+
+	size_t size() const { return m_list.size(); }
+
+	size_t hits = 0;
+	size_t misses = 0;
+
+private:
+	using List = std::list<std::pair<K, V>>;
+
+	const size_t m_capacity;
+	List m_list; // front: most recently used
+	std::unordered_map<K, typename List::iterator> m_map;
+};
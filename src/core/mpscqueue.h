@@ -0,0 +1,63 @@
+#pragma once
+
+#include "macros.h"
+#include <atomic>
+
+/// Unbounded lock-free queue for multiple producers and a single consumer.
+/// Intrusive node list with a stub node (D. Vyukov). `T` must be default
+/// constructible and movable.
+template<typename T>
+class MPSCQueue {
+public:
+	MPSCQueue()
+	{
+		m_tail = new Node();
+		m_head.store(m_tail, std::memory_order_relaxed);
+	}
+
+	~MPSCQueue()
+	{
+		T discard;
+		while (pop(discard))
+			;
+		delete m_tail;
+	}
+
+	DISABLE_COPY(MPSCQueue)
+
+	/// Any thread. Never blocks.
+	void push(T &&value)
+	{
+		Node *node = new Node();
+		node->value = std::move(value);
+
+		Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+		// Consumer cannot pass "prev" until this store is visible
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/// Consumer thread only. Returns false when empty (or a `push` is
+	/// yet to complete), `out` is left untouched in that case.
+	bool pop(T &out)
+	{
+		Node *tail = m_tail;
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+
+		// "next" becomes the new stub node
+		out = std::move(next->value);
+		m_tail = next;
+		delete tail;
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic<Node *> next { nullptr };
+		T value;
+	};
+
+	std::atomic<Node *> m_head; // last pushed
+	Node *m_tail; // stub, owned by the consumer
+};
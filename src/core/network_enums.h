@@ -25,6 +25,10 @@ enum class Packet2Client : uint16_t {
 	MediaList,
 	MediaReceive,
 	ScriptEvent,
+	WorldChunks, // streamed world data, proto >= 13
+	Bundle, // length-prefixed messages, proto >= 15
+	Bulk, // sequence number + message on channel 2, proto >= 16
+	BulkBarrier, // awaits a Bulk sequence number, proto >= 16
 	MAX_END
 };
 
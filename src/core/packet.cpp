@@ -43,9 +43,22 @@ Packet::Packet(Packet *pkt)
 	data_version = pkt->data_version;
 }
 
+Packet::Packet(Packet &&pkt) :
+	data_version(pkt.data_version),
+	m_is_big_endian(pkt.m_is_big_endian),
+	m_read_offset(pkt.m_read_offset),
+	m_write_offset(pkt.m_write_offset),
+	m_data(pkt.m_data)
+{
+	pkt.m_data = nullptr; // take over the reference
+}
+
 
 Packet::~Packet()
 {
+	if (!m_data)
+		return; // moved
+
 	if (m_data->referenceCount < 1) {
 		fprintf(stderr, "Counting is difficult %s\n", dump().c_str());
 		std::terminate();
@@ -189,6 +202,7 @@ void Packet::writePreallocEnd(size_t nbytes)
 	template TYPE Packet::read<TYPE>(); \
 	template void Packet::write<TYPE>(TYPE);
 
+DEFINE_PACKET_TYPES(int8_t)
 DEFINE_PACKET_TYPES(uint8_t)
 DEFINE_PACKET_TYPES(int16_t)
 DEFINE_PACKET_TYPES(uint16_t)
@@ -23,7 +23,7 @@ public:
 
 	~Packet();
 	DISABLE_COPY(Packet);
-	Packet(Packet &&) = default;
+	Packet(Packet &&pkt);
 
 	void setBigEndian(bool b = true) { m_is_big_endian = b; }
 	inline size_t getReadPos() const { return m_read_offset; };
@@ -8,10 +8,72 @@
 #include "world.h"
 #include "worldmeta.h"
 #include <rect.h>
+#include <algorithm> // std::clamp
+#include <cmath>
+#include <limits>
 
 constexpr float DISTANCE_STEP = 0.4f; // absolute max is 0.5f
 constexpr float VELOCITY_MAX = 200.0f;
 
+/*
+	Compact physics, protocol version 14+
+		u8 mask: bits 0..2: PhysicsGroup, bit 3: jump, bits 4..7: direction
+		u8 dtime_delay (2 ms)
+		u16 + u8 for each pos.X, pos.Y (fixed-point, 1/256 blocks)
+		[PG_VEL]   s16 vel.X, vel.Y (1/128 blocks/s)
+		[PG_ACC]   s8 acc.X, acc.Y (4 blocks/s²)
+		[PG_STATE] u32 PRNG state, u8 coins
+		[analog direction] s8 dir.X, dir.Y (1/127)
+*/
+constexpr u16 PROTOCOL_VERSION_COMPACT_PHYSICS = 14;
+constexpr float DELAY_SCALE = 500;
+constexpr float POS_SCALE = 256;
+constexpr float VEL_SCALE = 128;
+constexpr float ACC_SCALE = 0.25f;
+constexpr float DIR_SCALE = 127;
+constexpr u8 PHYSICS_REPEAT = 3; // resend changed groups N times
+constexpr u8 PHYSICS_KEYFRAME_INTERVAL = 16; // packets
+
+template<typename T>
+static T quantize(float value, float scale)
+{
+	const float v = std::round(value * scale);
+	if (!(v == v))
+		return 0; // NaN
+	return (T)std::clamp<float>(v, std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+}
+
+static void write_fixed_pos(Packet &pkt, float value)
+{
+	const u32 v = std::min<u32>(quantize<u32>(value, POS_SCALE), 0x00FFFFFF);
+	pkt.write<u16>(v >> 8);
+	pkt.write<u8>(v & 0xFF);
+}
+
+static float read_fixed_pos(Packet &pkt)
+{
+	u32 v = (u32)pkt.read<u16>() << 8;
+	v |= pkt.read<u8>();
+	return v / POS_SCALE;
+}
+
+/// 0: none, 1: positive, 2: negative, 3: analog
+static u8 encode_dir(float v)
+{
+	if (v == 0)
+		return 0;
+	if (v == 1)
+		return 1;
+	if (v == -1)
+		return 2;
+	return 3;
+}
+
+static float decode_dir(u8 code)
+{
+	return code == 1 ? 1 : (code == 2 ? -1 : 0);
+}
+
 Player::Player(peer_t peer_id) :
 	peer_id(peer_id),
 	m_world(nullptr)
@@ -48,6 +110,7 @@ void Player::setWorld(RefCnt<World> world)
 	m_script = world ? m_script_backup : nullptr;
 
 	controls_enabled = true;
+	m_physics_tx.packets = 0; // keyframe next
 	if (!keep_progress) {
 		setPosition({0, 0}, true);
 		setGodMode(false);
@@ -70,6 +133,45 @@ void Player::readPhysics(Packet &pkt)
 {
 	ASSERT_FORCED(pkt.data_version != 0, "invalid proto ver");
 
+	if (pkt.data_version >= PROTOCOL_VERSION_COMPACT_PHYSICS) {
+		PhysicsBaseline &b = m_physics_rx;
+
+		const u8 mask = pkt.read<u8>();
+		dtime_delay = pkt.read<u8>() / DELAY_SCALE;
+		pos.X = read_fixed_pos(pkt);
+		pos.Y = read_fixed_pos(pkt);
+
+		if (mask & PG_VEL) {
+			b.vel[0] = pkt.read<s16>();
+			b.vel[1] = pkt.read<s16>();
+		}
+		if (mask & PG_ACC) {
+			b.acc[0] = pkt.read<s8>();
+			b.acc[1] = pkt.read<s8>();
+		}
+		if (mask & PG_STATE) {
+			b.prng_state = pkt.read<u32>();
+			b.coins = pkt.read<u8>();
+		}
+
+		vel = core::vector2df(b.vel[0], b.vel[1]) / VEL_SCALE;
+		acc = core::vector2df(b.acc[0], b.acc[1]) / ACC_SCALE;
+		m_prng_state = b.prng_state;
+		coins = b.coins;
+
+		m_controls.jump = mask & 0x08;
+		const u8 dir_x = (mask >> 4) & 0x03;
+		const u8 dir_y = (mask >> 6) & 0x03;
+		if (dir_x == 3 || dir_y == 3) {
+			m_controls.dir.X = pkt.read<s8>() / DIR_SCALE;
+			m_controls.dir.Y = pkt.read<s8>() / DIR_SCALE;
+		} else {
+			m_controls.dir.X = decode_dir(dir_x);
+			m_controls.dir.Y = decode_dir(dir_y);
+		}
+		return;
+	}
+
 	pkt.read(dtime_delay);
 
 	pkt.read(pos.X);
@@ -92,10 +194,43 @@ void Player::readPhysics(Packet &pkt)
 
 }
 
-void Player::writePhysics(Packet &pkt) const
+void Player::writePhysics(Packet &pkt, u8 groups) const
 {
 	ASSERT_FORCED(pkt.data_version != 0, "invalid proto ver");
 
+	if (pkt.data_version >= PROTOCOL_VERSION_COMPACT_PHYSICS) {
+		// Key presses are sent as-is, not normalized
+		u8 dir_x = encode_dir(m_controls.dir.X);
+		u8 dir_y = encode_dir(m_controls.dir.Y);
+		const bool analog = dir_x == 3 || dir_y == 3;
+		if (analog)
+			dir_x = dir_y = 3;
+
+		groups &= PG_ALL;
+		pkt.write<u8>(groups | (m_controls.jump << 3) | (dir_x << 4) | (dir_y << 6));
+		pkt.write<u8>(quantize<u8>(dtime_delay, DELAY_SCALE));
+		write_fixed_pos(pkt, pos.X);
+		write_fixed_pos(pkt, pos.Y);
+
+		if (groups & PG_VEL) {
+			pkt.write<s16>(quantize<s16>(vel.X, VEL_SCALE));
+			pkt.write<s16>(quantize<s16>(vel.Y, VEL_SCALE));
+		}
+		if (groups & PG_ACC) {
+			pkt.write<s8>(quantize<s8>(acc.X, ACC_SCALE));
+			pkt.write<s8>(quantize<s8>(acc.Y, ACC_SCALE));
+		}
+		if (groups & PG_STATE) {
+			pkt.write<u32>(m_prng_state);
+			pkt.write<u8>(coins);
+		}
+		if (analog) {
+			pkt.write<s8>(quantize<s8>(m_controls.dir.X, DIR_SCALE));
+			pkt.write<s8>(quantize<s8>(m_controls.dir.Y, DIR_SCALE));
+		}
+		return;
+	}
+
 	pkt.write(dtime_delay);
 
 	pkt.write(pos.X);
@@ -120,6 +255,45 @@ void Player::writePhysics(Packet &pkt) const
 	pkt.write(dir_normal.Y);
 }
 
+u8 Player::updatePhysicsBaseline()
+{
+	PhysicsBaseline &b = m_physics_tx;
+
+	const s16 vel_q[2] = { quantize<s16>(vel.X, VEL_SCALE), quantize<s16>(vel.Y, VEL_SCALE) };
+	const s8 acc_q[2] = { quantize<s8>(acc.X, ACC_SCALE), quantize<s8>(acc.Y, ACC_SCALE) };
+	const bool changed[3] = {
+		vel_q[0] != b.vel[0] || vel_q[1] != b.vel[1],
+		acc_q[0] != b.acc[0] || acc_q[1] != b.acc[1],
+		m_prng_state != b.prng_state || coins != b.coins
+	};
+
+	for (int i = 0; i < 2; ++i) {
+		b.vel[i] = vel_q[i];
+		b.acc[i] = acc_q[i];
+	}
+	b.prng_state = m_prng_state;
+	b.coins = coins;
+
+	// Unreliable packets: repeat the changes and send all fields periodically.
+	// Acknowledged baselines would need per-receiver encoding, whereas
+	// `Server::stepSendMovement` shares one packet among all receivers.
+	// A receiver is outdated only if all repetitions are lost, and at most
+	// until the next keyframe (see `test_compact_physics_loss`: 0.03 % of
+	// the packets at 5 % loss, 0.6 % at 20 % loss).
+	const bool keyframe = (b.packets++ % PHYSICS_KEYFRAME_INTERVAL) == 0;
+	u8 groups = 0;
+	for (int i = 0; i < 3; ++i) {
+		if (changed[i])
+			b.repeat[i] = PHYSICS_REPEAT;
+
+		if (keyframe || b.repeat[i] > 0)
+			groups |= 1 << i;
+		if (b.repeat[i] > 0)
+			b.repeat[i]--;
+	}
+	return groups;
+}
+
 bool Player::setControls(const PlayerControls &ctrl)
 {
 	bool changed = !(ctrl == m_controls);
@@ -33,8 +33,19 @@ public:
 
 	void setScript(Script *script);
 
+	/// Groups of rarely changing fields in the compact physics (protocol 14+)
+	enum PhysicsGroup : u8 {
+		PG_VEL   = 0x01,
+		PG_ACC   = 0x02,
+		PG_STATE = 0x04, // PRNG and coins
+		PG_ALL   = 0x07
+	};
+
 	void readPhysics(Packet &pkt);
-	void writePhysics(Packet &pkt) const;
+	/// `groups`: see `updatePhysicsBaseline`. Older protocols send all.
+	void writePhysics(Packet &pkt, u8 groups = PG_ALL) const;
+	/// To call once per Move packet. Returns the `PhysicsGroup`s to send.
+	u8 updatePhysicsBaseline();
 
 	PlayerControls getControls() { return m_controls; }
 	// True: outdated controls -> send update to server
@@ -106,4 +117,18 @@ protected:
 
 	u32 m_prng_state;
 	float m_jump_cooldown = 0;
+
+	/// Quantized values of the last sent or received compact physics.
+	/// Omitted groups are taken from the baseline.
+	struct PhysicsBaseline {
+		s16 vel[2] = {};
+		s8 acc[2] = {};
+		u32 prng_state = 0;
+		u8 coins = 0;
+
+		// Sender only
+		u8 repeat[3] = {}; // per group, against packet loss
+		u8 packets = 0; // for periodic keyframes
+	};
+	PhysicsBaseline m_physics_tx, m_physics_rx;
 };
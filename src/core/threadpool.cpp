@@ -0,0 +1,111 @@
+#include "threadpool.h"
+#include <algorithm> // std::find
+#include <exception>
+
+struct ThreadPool::Batch {
+	const std::function<void(size_t)> *func;
+	size_t count;
+
+	// Protected by m_lock
+	size_t next = 0;
+	size_t done = 0;
+	std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(size_t n_threads)
+{
+	if (n_threads == 0) {
+		size_t hw = std::thread::hardware_concurrency();
+		n_threads = hw > 1 ? hw - 1 : 0;
+	}
+
+	m_threads.reserve(n_threads);
+	for (size_t i = 0; i < n_threads; ++i)
+		m_threads.emplace_back(&ThreadPool::workerMain, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		SimpleLock lock(m_lock);
+		m_stop = true;
+	}
+	m_cv_work.notify_all();
+
+	for (std::thread &t : m_threads)
+		t.join();
+}
+
+ThreadPool &ThreadPool::getShared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &func)
+{
+	if (m_threads.empty() || count <= 1) {
+		// Not worth the synchronization
+		for (size_t i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	Batch batch;
+	batch.func = &func;
+	batch.count = count;
+
+	SimpleLock lock(m_lock);
+	m_batches.push_back(&batch);
+	m_cv_work.notify_all();
+
+	while (batch.next < batch.count)
+		processOne(&batch, lock);
+
+	m_cv_done.wait(lock, [&batch] {
+		return batch.done == batch.count;
+	});
+
+	if (batch.error)
+		std::rethrow_exception(batch.error);
+}
+
+void ThreadPool::workerMain()
+{
+	SimpleLock lock(m_lock);
+	while (true) {
+		m_cv_work.wait(lock, [this] {
+			return m_stop || !m_batches.empty();
+		});
+		if (m_stop)
+			return;
+
+		processOne(m_batches.front(), lock);
+	}
+}
+
+void ThreadPool::processOne(Batch *batch, SimpleLock &lock)
+{
+	const size_t index = batch->next++;
+	if (batch->next == batch->count) {
+		// No indices left to hand out
+		auto it = std::find(m_batches.begin(), m_batches.end(), batch);
+		if (it != m_batches.end())
+			m_batches.erase(it);
+	}
+
+	lock.unlock();
+	std::exception_ptr error;
+	try {
+		(*batch->func)(index);
+	} catch (...) {
+		error = std::current_exception();
+	}
+	lock.lock();
+
+	if (error && !batch->error)
+		batch->error = error;
+
+	if (++batch->done == batch->count)
+		m_cv_done.notify_all();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "macros.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/// Fixed-size worker pool for short, CPU-bound tasks (e.g. compression).
+/// Multiple threads may call `run` concurrently.
+class ThreadPool {
+public:
+	/// n_threads = 0: use all but one hardware thread
+	ThreadPool(size_t n_threads = 0);
+	~ThreadPool();
+	DISABLE_COPY(ThreadPool)
+
+	/// Calls `func(i)` for i = [0, count) and waits for completion.
+	/// The calling thread helps out. The first thrown exception is re-thrown.
+	void run(size_t count, const std::function<void(size_t)> &func);
+
+	/// Amount of worker threads (excluding the caller of `run`)
+	size_t getThreadCount() const { return m_threads.size(); }
+
+	/// Lazily created pool, shared by the entire process
+	static ThreadPool &getShared();
+
+private:
+	struct Batch;
+
+	void workerMain();
+	/// Processes the next index of the batch. `lock` must be owned.
+	void processOne(Batch *batch, SimpleLock &lock);
+
+	std::mutex m_lock;
+	std::condition_variable m_cv_work;
+	std::condition_variable m_cv_done;
+	std::deque<Batch *> m_batches; // with pending indices
+	bool m_stop = false;
+
+	std::vector<std::thread> m_threads;
+};
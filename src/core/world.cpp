@@ -1,5 +1,6 @@
 #include "world.h"
 #include "blockmanager.h"
+#include "blockscan.h"
 #include "compressor.h"
 #include "logger.h"
 #include "macros.h"
@@ -7,7 +8,7 @@
 #include "packet.h"
 #include "utils.h" // strtrim
 #include "worldmeta.h"
-#include <cstring> // memset
+#include "threadpool.h"
 #include "script/scriptevent.h" // static_assert in std::unique_ptr
 
 static Logger logger("World", LL_INFO);
@@ -92,6 +93,38 @@ void BlockUpdate::write(Packet &pkt) const
 	params.write(pkt);
 }
 
+
+void BlockUpdateQueue::insert(const BlockUpdate &bu)
+{
+	const u64 key = getKey(bu);
+	auto it = m_pending.find(key);
+	if (it != m_pending.end()) {
+		// Intermediate states are not relevant
+		it->second = bu;
+		return;
+	}
+
+	m_pending.emplace(key, bu);
+	m_order.push_back(key);
+}
+
+const BlockUpdate &BlockUpdateQueue::front() const
+{
+	return m_pending.at(m_order.front());
+}
+
+void BlockUpdateQueue::pop_front()
+{
+	m_pending.erase(m_order.front());
+	m_order.pop_front();
+}
+
+void BlockUpdateQueue::clear()
+{
+	m_pending.clear();
+	m_order.clear();
+}
+
 // Used for network only!
 void IWorldMeta::readCommon(Packet &pkt)
 {
@@ -118,6 +151,19 @@ void IWorldMeta::writeCommon(Packet &pkt) const
 	pkt.write<u32>(plays);
 }
 
+// -------------- WorldChunk -------------
+
+const WorldChunk WorldChunk::EMPTY;
+
+bool WorldChunk::isEmpty() const
+{
+	for (const Block &b : blocks) {
+		if (b.id || b.bg || b.tile)
+			return false;
+	}
+	return true;
+}
+
 // -------------- World class -------------
 
 std::shared_ptr<World> World::copyNewSkeleton() const
@@ -127,34 +173,86 @@ std::shared_ptr<World> World::copyNewSkeleton() const
 	return world;
 }
 
+// Blocks that are searched for frequently (respawns, key/switch/timer events)
+static const bid_t INDEXED_BLOCK_IDS[] = {
+	Block::ID_SPAWN,
+	Block::ID_CHECKPOINT,
+	Block::ID_TELEPORTER,
+	Block::ID_COIN,
+	Block::ID_COINDOOR,
+	Block::ID_COINGATE,
+	Block::ID_KEY_R, Block::ID_KEY_G, Block::ID_KEY_B,
+	Block::ID_DOOR_R, Block::ID_DOOR_G, Block::ID_DOOR_B,
+	Block::ID_GATE_R, Block::ID_GATE_G, Block::ID_GATE_B,
+	Block::ID_SWITCH,
+	Block::ID_SWITCH_DOOR,
+	Block::ID_SWITCH_GATE,
+	Block::ID_TIMED_GATE_1,
+	Block::ID_TIMED_GATE_2,
+	Block::ID_SECRET,
+	Block::ID_BLACKFAKE,
+};
+
+static inline u32 pack_pos(blockpos_t pos)
+{
+	return (u32)pos.Y << 16 | pos.X;
+}
+
+static inline blockpos_t unpack_pos(u32 packed)
+{
+	return blockpos_t(packed & 0xFFFF, packed >> 16);
+}
+
 World::World(const BlockManager *bmgr, const std::string &id) :
 	m_bmgr(bmgr)
 {
-	modified_rect = make_rect_not_modified();
+	for (bid_t id : INDEXED_BLOCK_IDS)
+		m_block_index[id]; // create
 	m_meta = std::make_shared<WorldMeta>(id);
 	logger(LL_INFO, "Create %s", m_meta->id.c_str());
 }
 
+World::World(const World &source, SnapshotTag) :
+	m_size(source.m_size),
+	m_bmgr(source.m_bmgr),
+	m_meta(source.m_meta),
+	m_chunks_size(source.m_chunks_size),
+	m_chunks(source.m_chunks),
+	m_params(source.m_params),
+	m_block_index(source.m_block_index),
+	m_is_snapshot(true)
+{
+}
+
 World::~World()
 {
-	logger(LL_INFO, "Delete %s", m_meta->id.c_str());
-	delete[] m_data;
+	if (!m_is_snapshot)
+		logger(LL_INFO, "Delete %s", m_meta->id.c_str());
+}
+
+std::shared_ptr<const World> World::createSnapshot() const
+{
+	return std::shared_ptr<const World>(new World(*this, SnapshotTag()));
 }
 
 void World::createEmpty(blockpos_t size)
 {
 	if (size.X == 0 || size.Y == 0)
 		throw std::length_error("Invalid size");
-	if (m_data)
-		delete[] m_data;
 
-	markAllModified();
 	m_size = size;
+	dirty.resize(size);
+
+	// Round up to cover partial chunks at the edges
+	m_chunks_size.X = (m_size.X + WorldChunk::MASK) >> WorldChunk::SIZE_LOG2;
+	m_chunks_size.Y = (m_size.Y + WorldChunk::MASK) >> WorldChunk::SIZE_LOG2;
 
-	const size_t length = m_size.X * m_size.Y;
-	m_data = new Block[length];
+	// All air: no allocations needed
+	m_chunks.clear();
+	m_chunks.resize((size_t)m_chunks_size.X * m_chunks_size.Y);
 
-	memset((void *)m_data, 0, length);
+	for (auto &it : m_block_index)
+		it.second.clear();
 }
 
 void World::createDummy(blockpos_t size)
@@ -163,10 +261,52 @@ void World::createDummy(blockpos_t size)
 
 	for (u16 y = m_size.Y / 2; y < (u16)m_size.Y; ++y)
 	for (u16 x = 0; x < (u16)m_size.X; ++x) {
-		getBlockRefNoCheck({x, y}).id = 9;
+		getBlockRefForWrite({x, y}).id = 9;
+	}
+	rebuildBlockIndex();
+}
+
+/// from_disk = false: the block properties are in sync with the server
+static void read_params_mapper(Packet &pkt, bool from_disk, const BlockManager *bmgr,
+	std::map<bid_t, BlockParams::Type> &mapper)
+{
+	if (from_disk) {
+		// Load params from the disk
+		while (true) {
+			bid_t id = pkt.read<bid_t>();
+			if (!id)
+				break;
+
+			mapper.emplace(id, (BlockParams::Type)pkt.read<uint8_t>());
+		}
+	} else {
+		// In sync with the server, sent params upon connect
+		const auto &props = bmgr->getProps();
+
+		for (size_t i = 0; i < props.size(); ++i) {
+			if (!props[i] || props[i]->paramtypes == BlockParams::Type::None)
+				continue;
+
+			mapper.emplace(i, props[i]->paramtypes);
+		}
 	}
 }
 
+static void write_params_mapper(Packet &pkt, const BlockManager *bmgr)
+{
+	// Mapping of the known types
+	auto &list = bmgr->getProps();
+	for (size_t i = 0; i < list.size(); ++i) {
+		auto props = list[i];
+		if (!props || props->paramtypes == BlockParams::Type::None)
+			continue;
+
+		pkt.write<bid_t>(i);
+		pkt.write<u8>((u8)props->paramtypes);
+	}
+	pkt.write<bid_t>(0); // terminator
+}
+
 static constexpr u32 SIGNATURE = 0x6677454F; // OEwf
 static constexpr u16 VALIDATION = 0x4B4F; // OK
 
@@ -186,9 +326,17 @@ void World::read(Packet &pkt)
 
 	switch (method) {
 		case Method::Dummy: break;
+		case Method::Chunks:
+			// Filled by `readChunks`
+			createEmpty(m_size);
+			m_params.clear();
+			break;
 		case Method::Plain:
 			readPlain(pkt);
 			break;
+		case Method::CompressionV1:
+			readCompressionV1(pkt);
+			break;
 		default:
 			throw std::runtime_error("Unsupported world read method");
 	}
@@ -196,6 +344,7 @@ void World::read(Packet &pkt)
 	if (pkt.read<u16>() != VALIDATION)
 		throw std::runtime_error("EOF validation mismatch");
 
+	rebuildBlockIndex();
 	markAllModified();
 	// good. done
 }
@@ -210,9 +359,13 @@ void World::write(Packet &pkt, Method method) const
 
 	switch (method) {
 		case Method::Dummy: break;
+		case Method::Chunks: break; // written separately
 		case Method::Plain:
 			writePlain(pkt);
 			break;
+		case Method::CompressionV1:
+			writeCompressionV1(pkt);
+			break;
 		default:
 			throw std::runtime_error("Unsupported world write method");
 	}
@@ -223,46 +376,77 @@ void World::write(Packet &pkt, Method method) const
 void World::readPlain(Packet &pkt_in)
 {
 	u8 version = pkt_in.read<u8>();
-	if (version < 2 || version > 5)
+	if (version < 2 || version > 6)
 		throw std::runtime_error("Unsupported read version");
 
+	const bool is_disk = pkt_in.data_version == PROTOCOL_VERSION_FAKE_DISK;
+	// Simple 500 * 500 worlds are about 1 MB (decompressed)
+	constexpr size_t DECOMPRESS_LIMIT = 10 * (1024 * 1024); // 10 MiB must suffice
+
+	ParamsMapper mapper;
+	m_params.clear();
+
+	if (version >= 6) {
+		// Independently compressed row bands (older disk data, read-only)
+		const u16 band_height = pkt_in.read<u16>();
+		if (band_height == 0)
+			throw std::runtime_error("Invalid band height");
+
+		std::vector<std::unique_ptr<Packet>> streams;
+		Decompressor::decompressParallel(streams, pkt_in, DECOMPRESS_LIMIT);
+
+		const size_t n_bands = (m_size.Y + band_height - 1) / band_height;
+		if (streams.size() != 1 + n_bands)
+			throw std::runtime_error("Band count mismatch");
+
+		// First stream: metadata
+		read_params_mapper(*streams[0], is_disk, m_bmgr, mapper);
+
+		std::vector<PlainParamsList> params(n_bands);
+		auto read_band = [&] (size_t i) {
+			const size_t y0 = i * band_height;
+			readPlainRows(*streams[1 + i], version, mapper, y0,
+				std::min<size_t>(y0 + band_height, m_size.Y), params[i]);
+		};
+
+		// Each chunk must be written by one thread only
+		if (band_height % WorldChunk::SIZE == 0) {
+			ThreadPool::getShared().run(n_bands, read_band);
+		} else {
+			for (size_t i = 0; i < n_bands; ++i)
+				read_band(i);
+		}
+
+		for (auto &list : params) {
+			for (auto &it : list)
+				m_params.set(it.first, std::move(it.second));
+		}
+		return;
+	}
+
 	const bool is_compressed = version >= 5;
 	Packet pkt_tmp_decomp;
 	Packet &pkt = is_compressed ? pkt_tmp_decomp : pkt_in;
 	if (is_compressed) {
 		Decompressor d(&pkt, pkt_in);
-		// Simple 500 * 500 worlds are about 1 MB (decompressed)
-		d.setLimit(10 * (1024 * 1024)); // 10 MiB must suffice
+		d.setLimit(DECOMPRESS_LIMIT);
 		d.decompress();
 	}
 
 	// Describes the block parameters (thus length) that are to be expected
-	std::map<bid_t, BlockParams::Type> mapper;
-	if (pkt_in.data_version == PROTOCOL_VERSION_FAKE_DISK) {
-		// Load params from the disk
-		if (version >= 4) {
-			while (true) {
-				bid_t id = pkt.read<bid_t>();
-				if (!id)
-					break;
-
-				mapper.emplace(id, (BlockParams::Type)pkt.read<uint8_t>());
-			}
-		}
-	} else {
-		// In sync with the server, sent params upon connect
-		const auto &props = m_bmgr->getProps();
-
-		for (size_t i = 0; i < props.size(); ++i) {
-			if (!props[i] || props[i]->paramtypes == BlockParams::Type::None)
-				continue;
+	if (!is_disk || version >= 4)
+		read_params_mapper(pkt, is_disk, m_bmgr, mapper);
 
-			mapper.emplace(i, props[i]->paramtypes);
-		}
-	}
+	PlainParamsList params;
+	readPlainRows(pkt, version, mapper, 0, m_size.Y, params);
+	for (auto &it : params)
+		m_params.set(it.first, std::move(it.second));
+}
 
-	m_params.clear();
-	for (size_t y = 0; y < m_size.Y; ++y)
+void World::readPlainRows(Packet &pkt, u8 version, const ParamsMapper &mapper,
+	size_t y_start, size_t y_end, PlainParamsList &params)
+{
+	for (size_t y = y_start; y < y_end; ++y)
 	for (size_t x = 0; x < m_size.X; ++x) {
 		blockpos_t pos(x, y);
 
@@ -285,60 +469,49 @@ void World::readPlain(Packet &pkt_in)
 			if (val != BlockParams::Type::None) {
 				auto props = m_bmgr->getProps(b.id);
 				if (props && val == props->paramtypes)
-					m_params.emplace(pos, val);
+					params.emplace_back(pos, std::move(val));
 			}
 		}
 
-		getBlockRefNoCheck(pos) = b;
+		setBlockNoCheck(pos, b);
 	}
 }
 
 void World::writePlain(Packet &pkt_out) const
 {
+	// Version 6 (parallel row bands) is only read for older disk data
 	u8 version = 5;
-	//if (pkt_out.data_version >= 7)
-	//	version = 6;
 	pkt_out.write(version);
 
 	const bool do_compress = version >= 5;
 	Packet pkt_tmp_comp;
 	Packet &pkt = do_compress ? pkt_tmp_comp : pkt_out;
 
-	if (pkt_out.data_version == PROTOCOL_VERSION_FAKE_DISK) {
-		// Mapping of the known types
-		auto &list = m_bmgr->getProps();
-		for (size_t i = 0; i < list.size(); ++i) {
-			auto props = list[i];
-			if (!props || props->paramtypes == BlockParams::Type::None)
-				continue;
-
-			pkt.write<bid_t>(i);
-			pkt.write<u8>((u8)props->paramtypes);
-		}
-		pkt.write<bid_t>(0); // terminator
-	}
+	if (pkt_out.data_version == PROTOCOL_VERSION_FAKE_DISK)
+		write_params_mapper(pkt, m_bmgr);
 
 	pkt.ensureCapacity(m_size.X * m_size.Y * sizeof(Block));
 
 	// Compressing backgrounds separate can result in 5-8% smaller files.
 	// Busy worlds however benefit more from FG + BG in combination
 
-	for (const Block *b = begin(); b != end(); ++b) {
-		pkt.write(b->id);
-		pkt.write(b->bg);
+	for (size_t y = 0; y < m_size.Y; ++y)
+	for (size_t x = 0; x < m_size.X; ++x) {
+		const blockpos_t pos(x, y);
+		const Block &b = getBlockRefNoCheck(pos);
+		pkt.write(b.id);
+		pkt.write(b.bg);
 
-		auto props = m_bmgr->getProps(b->id);
+		auto props = m_bmgr->getProps(b.id);
 		if (!props || props->paramtypes == BlockParams::Type::None)
 			continue;
 
-		blockpos_t pos = getBlockPos(b);
-
 		// Write paramtype if there is any
-		auto it = m_params.find(pos);
-		if (it != m_params.end()) {
-			if (it->second != props->paramtypes)
+		const BlockParams *params = m_params.find(pos);
+		if (params) {
+			if (*params != props->paramtypes)
 				throw std::runtime_error("Unexpected param format");
-			it->second.write(pkt);
+			params->write(pkt);
 		} else {
 			// Placeholder in case of missing data
 			BlockParams params(props->paramtypes);
@@ -352,6 +525,410 @@ void World::writePlain(Packet &pkt_out) const
 	}
 }
 
+// LEB128-alike. Most runs and palette indices fit into a single byte.
+static void write_varint(Packet &pkt, u32 v)
+{
+	while (v >= 0x80) {
+		pkt.write<u8>((v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	pkt.write<u8>(v);
+}
+
+static u32 read_varint(Packet &pkt)
+{
+	u32 v = 0;
+	for (int shift = 0; shift < 32; shift += 7) {
+		u8 byte = pkt.read<u8>();
+		v |= (u32)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return v;
+	}
+	throw std::runtime_error("Varint too long");
+}
+
+/*
+	Format (after zlib decompression):
+		[disk only] params mapper, see `write_params_mapper`
+		u16 palette size N, followed by N * bid_t
+		FG layer, BG layer: runs of { varint palette index, varint length }
+			in row-major order until the world area is covered
+		u32 count, followed by { u16 x, u16 y, BlockParams } for each param
+*/
+void World::readCompressionV1(Packet &pkt_in)
+{
+	u8 version = pkt_in.read<u8>();
+	if (version != 1)
+		throw std::runtime_error("Unsupported read version");
+
+	Packet pkt;
+	{
+		Decompressor d(&pkt, pkt_in);
+		d.setLimit(10 * (1024 * 1024)); // see readPlain
+		d.decompress();
+	}
+
+	ParamsMapper mapper;
+	read_params_mapper(pkt, pkt_in.data_version == PROTOCOL_VERSION_FAKE_DISK,
+		m_bmgr, mapper);
+
+	std::vector<bid_t> palette(pkt.read<u16>());
+	for (bid_t &id : palette)
+		id = pkt.read<bid_t>();
+
+	// Start from scratch: air runs need no further processing
+	for (auto &chunk : m_chunks)
+		chunk.reset();
+	m_params.clear();
+
+	const size_t area = (size_t)m_size.X * m_size.Y;
+	for (int layer = 0; layer < 2; ++layer) {
+		const bool is_bg = layer == 1;
+
+		for (size_t i = 0; i < area; ) {
+			u32 index = read_varint(pkt);
+			u32 length = read_varint(pkt);
+			if (index >= palette.size() || length == 0 || length > area - i)
+				throw std::runtime_error("Invalid world run");
+
+			const bid_t id = palette[index];
+			if (id == 0) {
+				i += length;
+				continue;
+			}
+
+			for (const size_t end = i + length; i < end; ++i) {
+				blockpos_t pos(i % m_size.X, i / m_size.X);
+				Block &b = getBlockRefForWrite(pos);
+				if (is_bg)
+					b.bg = id;
+				else
+					b.id = id;
+			}
+		}
+	}
+
+	u32 count = pkt.read<u32>();
+	while (count--) {
+		blockpos_t pos;
+		pkt.read(pos.X);
+		pkt.read(pos.Y);
+		if (pos.X >= m_size.X || pos.Y >= m_size.Y)
+			throw std::runtime_error("Invalid params position");
+
+		const bid_t id = getBlockRefNoCheck(pos).id;
+		auto it = mapper.find(id);
+		if (it == mapper.end())
+			throw std::runtime_error("Unknown params type");
+
+		BlockParams val(it->second);
+		val.read(pkt);
+
+		auto props = m_bmgr->getProps(id);
+		if (props && val == props->paramtypes)
+			m_params.set(pos, std::move(val));
+	}
+}
+
+void World::writeCompressionV1(Packet &pkt_out) const
+{
+	pkt_out.write<u8>(1); // version
+
+	Packet pkt;
+	if (pkt_out.data_version == PROTOCOL_VERSION_FAKE_DISK)
+		write_params_mapper(pkt, m_bmgr);
+
+	// Palette shared by both layers
+	std::vector<bid_t> palette;
+	std::map<bid_t, u32> palette_lookup;
+	auto get_index = [&] (bid_t id) -> u32 {
+		auto it = palette_lookup.find(id);
+		if (it != palette_lookup.end())
+			return it->second;
+
+		palette.push_back(id);
+		palette_lookup.emplace(id, palette.size() - 1);
+		return palette.size() - 1;
+	};
+	get_index(0); // air first
+	forEachBlock([&] (blockpos_t pos, const Block &b) {
+		get_index(b.id);
+		get_index(b.bg);
+	});
+
+	pkt.write<u16>(palette.size());
+	for (bid_t id : palette)
+		pkt.write<bid_t>(id);
+
+	for (int layer = 0; layer < 2; ++layer) {
+		const bool is_bg = layer == 1;
+
+		bid_t run_id = 0;
+		u32 run_length = 0;
+		for (size_t y = 0; y < m_size.Y; ++y)
+		for (size_t x = 0; x < m_size.X; ++x) {
+			const Block &b = getBlockRefNoCheck(blockpos_t(x, y));
+			const bid_t id = is_bg ? b.bg : b.id;
+			if (id == run_id || run_length == 0) {
+				run_id = id;
+				run_length++;
+				continue;
+			}
+
+			write_varint(pkt, palette_lookup[run_id]);
+			write_varint(pkt, run_length);
+			run_id = id;
+			run_length = 1;
+		}
+		write_varint(pkt, palette_lookup[run_id]);
+		write_varint(pkt, run_length);
+	}
+
+	// Params out of band. Placeholders in case of missing data.
+	Packet pkt_count(&pkt);
+	pkt.write<u32>(0);
+	u32 count = 0;
+	forEachBlock([&] (blockpos_t pos, const Block &b) {
+		auto props = m_bmgr->getProps(b.id);
+		if (!props || props->paramtypes == BlockParams::Type::None)
+			return;
+
+		pkt.write(pos.X);
+		pkt.write(pos.Y);
+		const BlockParams *params = m_params.find(pos);
+		if (params) {
+			if (*params != props->paramtypes)
+				throw std::runtime_error("Unexpected param format");
+			params->write(pkt);
+		} else {
+			BlockParams params(props->paramtypes);
+			params.write(pkt);
+		}
+		count++;
+	});
+	pkt_count.write<u32>(count);
+
+	Compressor c(&pkt_out, pkt);
+	c.compress();
+}
+
+// FNV-1a (64 bits) on 32-bit words. Independent of the Block memory layout.
+static constexpr u64 CHUNK_HASH_SEED = 0xCBF29CE484222325ULL;
+
+static inline u64 chunk_hash_mix(u64 h, u32 v)
+{
+	return (h ^ v) * 0x100000001B3ULL;
+}
+
+std::vector<u64> World::getChunkHashes() const
+{
+	// All unallocated chunks are equal
+	u64 hash_empty = CHUNK_HASH_SEED;
+	for (size_t i = 0; i < WorldChunk::SIZE * WorldChunk::SIZE; ++i)
+		hash_empty = chunk_hash_mix(hash_empty, 0);
+
+	std::vector<u64> hashes(m_chunks.size(), hash_empty);
+	for (size_t i = 0; i < m_chunks.size(); ++i) {
+		const WorldChunk *chunk = m_chunks[i].get();
+		if (!chunk)
+			continue;
+
+		u64 h = CHUNK_HASH_SEED;
+		for (const Block &b : chunk->blocks)
+			h = chunk_hash_mix(h, (u32)b.bg << 16 | b.id);
+
+		// Params as serialized (including placeholders)
+		auto hash_params = [&] (blockpos_t pos, const Block &b) {
+			auto props = m_bmgr->getProps(b.id);
+			if (!props || props->paramtypes == BlockParams::Type::None)
+				return;
+
+			Packet pkt(16);
+			const BlockParams *params = m_params.find(pos);
+			if (params)
+				params->write(pkt);
+			else
+				BlockParams(props->paramtypes).write(pkt);
+			const u8 *data = pkt.data();
+			for (size_t n = 0; n < pkt.size(); ++n)
+				h = chunk_hash_mix(h, data[n]);
+			h = chunk_hash_mix(h, (u32)pos.Y << 16 | pos.X);
+		};
+		forEachBlockInChunk(i, *chunk, hash_params);
+		hashes[i] = h;
+	}
+	return hashes;
+}
+
+/*
+	Format (after zlib decompression):
+		u32 count, followed by { u32 chunk index, SIZE * SIZE * { bid_t id, bid_t bg } }
+		u32 count, followed by { u16 x, u16 y, BlockParams } for each param
+*/
+void World::writeChunks(Packet &pkt_out, const std::vector<size_t> &indices) const
+{
+	pkt_out.write<u8>(1); // version
+
+	Packet pkt;
+	pkt.write<u32>(indices.size());
+	for (size_t index : indices) {
+		const WorldChunk *chunk = m_chunks.at(index).get();
+		if (!chunk)
+			chunk = &WorldChunk::EMPTY;
+
+		pkt.write<u32>(index);
+		for (const Block &b : chunk->blocks) {
+			pkt.write(b.id);
+			pkt.write(b.bg);
+		}
+	}
+
+	Packet pkt_count(&pkt);
+	pkt.write<u32>(0);
+	u32 count = 0;
+	auto write_params = [&] (blockpos_t pos, const Block &b) {
+		auto props = m_bmgr->getProps(b.id);
+		if (!props || props->paramtypes == BlockParams::Type::None)
+			return;
+
+		pkt.write(pos.X);
+		pkt.write(pos.Y);
+		const BlockParams *params = m_params.find(pos);
+		if (params) {
+			if (*params != props->paramtypes)
+				throw std::runtime_error("Unexpected param format");
+			params->write(pkt);
+		} else {
+			BlockParams params(props->paramtypes);
+			params.write(pkt);
+		}
+		count++;
+	};
+	for (size_t index : indices) {
+		if (m_chunks[index])
+			forEachBlockInChunk(index, (const WorldChunk &)*m_chunks[index], write_params);
+	}
+	pkt_count.write<u32>(count);
+
+	Compressor c(&pkt_out, pkt);
+	c.compress();
+}
+
+void World::readChunks(Packet &pkt_in)
+{
+	u8 version = pkt_in.read<u8>();
+	if (version != 1)
+		throw std::runtime_error("Unsupported read version");
+
+	Packet pkt;
+	{
+		Decompressor d(&pkt, pkt_in);
+		d.setLimit(10 * (1024 * 1024)); // see readPlain
+		d.decompress();
+	}
+
+	std::vector<bool> replaced(m_chunks.size());
+	u32 count = pkt.read<u32>();
+	while (count--) {
+		const size_t index = pkt.read<u32>();
+		if (index >= m_chunks.size())
+			throw std::runtime_error("Invalid chunk index");
+		replaced[index] = true;
+
+		const blockpos_t origin = getChunkOrigin(index);
+		auto chunk = std::make_unique<WorldChunk>();
+		for (size_t i = 0; i < WorldChunk::SIZE * WorldChunk::SIZE; ++i) {
+			Block &b = chunk->blocks[i];
+			b.id = pkt.read<bid_t>();
+			b.bg = pkt.read<bid_t>();
+
+			// Outside of the world: must remain air
+			blockpos_t pos(origin.X + (i & WorldChunk::MASK), origin.Y + (i >> WorldChunk::SIZE_LOG2));
+			if (pos.X >= m_size.X || pos.Y >= m_size.Y)
+				b = Block();
+		}
+
+		if (chunk->isEmpty())
+			chunk.reset();
+		m_chunks[index] = std::move(chunk);
+	}
+
+	// Params of the replaced chunks are sent along
+	std::vector<blockpos_t> params_removed;
+	for (const auto &entry : m_params) {
+		if (replaced[getChunkIndex(entry.pos)])
+			params_removed.push_back(entry.pos);
+	}
+	for (blockpos_t pos : params_removed)
+		m_params.erase(pos);
+
+	count = pkt.read<u32>();
+	while (count--) {
+		blockpos_t pos;
+		pkt.read(pos.X);
+		pkt.read(pos.Y);
+		if (pos.X >= m_size.X || pos.Y >= m_size.Y || !replaced[getChunkIndex(pos)])
+			throw std::runtime_error("Invalid params position");
+
+		const bid_t id = getBlockRefNoCheck(pos).id;
+		auto props = m_bmgr->getProps(id);
+		if (!props || props->paramtypes == BlockParams::Type::None)
+			throw std::runtime_error("Unknown params type");
+
+		BlockParams val(props->paramtypes);
+		val.read(pkt);
+		m_params.set(pos, std::move(val));
+	}
+
+	// Partial index update: chunks may arrive in many small packets
+	for (auto &it : m_block_index) {
+		auto &list = it.second;
+		list.erase(std::remove_if(list.begin(), list.end(), [&] (u32 packed) {
+			return replaced[getChunkIndex(unpack_pos(packed))];
+		}), list.end());
+	}
+
+	const auto end = m_block_index.end();
+	auto add_to_index = [&] (blockpos_t pos, const Block &b) {
+		auto it = m_block_index.find(b.id);
+		if (it != end)
+			it->second.push_back(pack_pos(pos));
+	};
+	for (size_t i = 0; i < m_chunks.size(); ++i) {
+		if (!replaced[i])
+			continue;
+
+		dirty.mark(getChunkRect(i));
+
+		if (m_chunks[i])
+			forEachBlockInChunk(i, (const WorldChunk &)*m_chunks[i], add_to_index);
+	}
+
+	for (auto &it : m_block_index)
+		std::sort(it.second.begin(), it.second.end());
+}
+
+std::vector<size_t> World::getChunksUsedNear(blockpos_t pos) const
+{
+	const int cx = pos.X >> WorldChunk::SIZE_LOG2;
+	const int cy = pos.Y >> WorldChunk::SIZE_LOG2;
+	auto distance_sq = [&] (size_t index) {
+		const int dx = (int)(index % m_chunks_size.X) - cx;
+		const int dy = (int)(index / m_chunks_size.X) - cy;
+		return dx * dx + dy * dy;
+	};
+
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < m_chunks.size(); ++i) {
+		if (m_chunks[i])
+			indices.push_back(i);
+	}
+	std::stable_sort(indices.begin(), indices.end(), [&] (size_t a, size_t b) {
+		return distance_sq(a) < distance_sq(b);
+	});
+	return indices;
+}
+
 bool World::getBlock(blockpos_t pos, Block *block) const
 {
 	if (pos.X >= m_size.X || pos.Y >= m_size.Y)
@@ -368,21 +945,95 @@ bool World::setBlock(blockpos_t pos, const Block block)
 	if (pos.X >= m_size.X || pos.Y >= m_size.Y)
 		return false;
 
-	getBlockRefNoCheck(pos) = block;
-	modified_rect.addInternalPoint(pos);
+	updateBlockIndex(pos, getBlockRefNoCheck(pos).id, block.id);
+	setBlockNoCheck(pos, block);
+	dirty.mark(pos);
 	return true;
 }
 
-blockpos_t World::getBlockPos(const Block *b) const
+Block &World::getBlockRefForWrite(const blockpos_t pos)
 {
-	if (b < begin() || b >= end())
-		return blockpos_t(BLOCKPOS_INVALID, BLOCKPOS_INVALID);
+	const size_t index = getChunkIndex(pos);
+	if (!m_chunks[index])
+		m_chunks[index].reset(new WorldChunk());
+	return getChunkForWrite(index)->at(pos);
+}
 
-	size_t index = b - begin();
-	blockpos_t pos;
-	pos.Y = index / m_size.X;
-	pos.X = index - (pos.Y * m_size.X);
-	return pos;
+WorldChunk *World::getChunkForWrite(size_t index)
+{
+	auto &chunk = m_chunks[index];
+	// Snapshots are created under `mutex`, thus the count cannot increase
+	// concurrently. A stale (higher) count results in an unneeded copy.
+	if (chunk && chunk.use_count() > 1)
+		chunk = std::make_shared<WorldChunk>(*chunk);
+	return chunk.get();
+}
+
+void World::setBlockNoCheck(const blockpos_t pos, const Block b)
+{
+	const bool is_air = !b.id && !b.bg && !b.tile;
+	if (is_air && !m_chunks[getChunkIndex(pos)])
+		return; // Already air
+
+	getBlockRefForWrite(pos) = b;
+	if (is_air)
+		releaseChunkIfEmpty(pos);
+}
+
+void World::releaseChunkIfEmpty(const blockpos_t pos)
+{
+	auto &chunk = m_chunks[getChunkIndex(pos)];
+	if (chunk && chunk->isEmpty())
+		chunk.reset();
+}
+
+void World::updateBlockIndex(blockpos_t pos, bid_t old_id, bid_t new_id)
+{
+	if (old_id == new_id)
+		return;
+
+	const u32 packed = pack_pos(pos);
+	auto it = m_block_index.find(old_id);
+	if (it != m_block_index.end()) {
+		auto &list = it->second;
+		auto lb = std::lower_bound(list.begin(), list.end(), packed);
+		if (lb != list.end() && *lb == packed)
+			list.erase(lb);
+	}
+
+	it = m_block_index.find(new_id);
+	if (it != m_block_index.end()) {
+		auto &list = it->second;
+		auto lb = std::lower_bound(list.begin(), list.end(), packed);
+		if (lb == list.end() || *lb != packed)
+			list.insert(lb, packed);
+	}
+}
+
+void World::rebuildBlockIndex()
+{
+	for (auto &it : m_block_index)
+		it.second.clear();
+
+	// const: must not unshare chunks held by snapshots
+	const auto end = m_block_index.end();
+	static_cast<const World *>(this)->forEachBlock([&] (blockpos_t pos, const Block &b) {
+		auto it = m_block_index.find(b.id);
+		if (it != end)
+			it->second.push_back(pack_pos(pos));
+	});
+
+	// Chunk order -> row-major
+	for (auto &it : m_block_index)
+		std::sort(it.second.begin(), it.second.end());
+}
+
+size_t World::getChunkCountUsed() const
+{
+	size_t count = 0;
+	for (const auto &chunk : m_chunks)
+		count += !!chunk;
+	return count;
 }
 
 const Block *World::getBlockPtr(blockpos_t pos) const
@@ -402,7 +1053,7 @@ bool World::checkUpdateBlockNeeded(BlockUpdate &bu)
 	if (!bu.check(&new_id, &is_background))
 		return false;
 
-	Block &ref = getBlockRefNoCheck(bu.pos);
+	const Block &ref = getBlockRefNoCheck(bu.pos);
 	if (is_background)
 		return new_id != ref.bg;
 
@@ -419,29 +1070,33 @@ bool World::checkUpdateBlockNeeded(BlockUpdate &bu)
 	return false;
 }
 
-Block *World::updateBlock(BlockUpdate bu)
+bool World::updateBlock(BlockUpdate bu)
 {
 	if (!checkUpdateBlockNeeded(bu))
-		return nullptr;
+		return false;
 
-	return &updateBlockNoCheck(bu);
+	updateBlockNoCheck(bu);
+	return true;
 }
 
-Block &World::updateBlockNoCheck(BlockUpdate bu)
+Block World::updateBlockNoCheck(BlockUpdate bu)
 {
-	Block &ref = getBlockRefNoCheck(bu.pos);
+	Block b = getBlockRefNoCheck(bu.pos);
 	if (bu.isBackground()) {
-		ref.bg = bu.getId();
+		b.bg = bu.getId();
 	} else {
-		m_params.erase(bu.pos);
-		ref.tile = 0;
-		ref.id = bu.getId(); // reset tile information
+		updateBlockIndex(bu.pos, b.id, bu.getId());
+		b.tile = 0;
+		b.id = bu.getId(); // reset tile information
 		if (bu.params != BlockParams::Type::None)
-			m_params.emplace(bu.pos, bu.params);
+			m_params.set(bu.pos, bu.params);
+		else
+			m_params.erase(bu.pos);
 	}
-	modified_rect.addInternalPoint(bu.pos);
+	setBlockNoCheck(bu.pos, b);
+	dirty.mark(bu.pos);
 
-	return ref;
+	return b;
 }
 
 bool World::setBlockTiles(PositionRange &range, bid_t block_id, int tile)
@@ -450,86 +1105,159 @@ bool World::setBlockTiles(PositionRange &range, bid_t block_id, int tile)
 
 	const O op = range.op;
 
-	core::rect<u16> rect = make_rect_not_modified();
+	if (op != O::PROP_SET && op != O::PROP_ADD)
+		return false; // invalid
+
+	bool modified = false;
 	blockpos_t pos;
 
-	if (range.type == PositionRange::PRT_ENTIRE_WORLD && op == O::PROP_SET) {
-		// Optimization
-		for (Block *b = begin(); b != end(); ++b) {
-			if (b->id == block_id) {
-				b->tile = tile;
-				rect.addInternalPoint(getBlockPos(b));
+	auto apply = [op, tile] (Block &b) {
+		if (op == O::PROP_SET) {
+			b.tile = tile;
+		} else {
+			// Disallow underflows
+			// Issue: (255 + N) becomes 0 too.
+			int sum = tile + (int)b.tile;
+			b.tile = (sum == (int)(uint8_t)sum) * sum;
+		}
+	};
+
+	if (range.type == PositionRange::PRT_ENTIRE_WORLD) {
+		auto it = m_block_index.find(block_id);
+		if (it != m_block_index.end()) {
+			// Optimization: known positions
+			for (u32 packed : it->second) {
+				pos = unpack_pos(packed);
+				apply(getBlockRefForWrite(pos));
+				dirty.mark(pos);
+				modified = true;
 			}
+			goto done;
+		}
+
+		if (op == O::PROP_SET && block_id != 0) {
+			// Optimization: unallocated chunks contain air only.
+			// Blocks outside of the world are air too, hence scan entire chunks.
+			for (size_t i = 0; i < m_chunks.size(); ++i) {
+				const WorldChunk *chunk = m_chunks[i].get();
+				if (!chunk)
+					continue;
+
+				// Do not unshare unaffected chunks
+				if (m_chunks[i].use_count() > 1 && !blockscan_find_id(chunk->blocks,
+						WorldChunk::SIZE * WorldChunk::SIZE, block_id, nullptr))
+					continue;
+
+				if (!blockscan_set_tile(getChunkForWrite(i)->blocks, WorldChunk::SIZE * WorldChunk::SIZE,
+						block_id, tile))
+					continue;
+
+				dirty.mark(getChunkRect(i));
+				modified = true;
+			}
+			goto done;
 		}
-		goto done;
 	}
 
 	for (bool ok = range.iteratorStart(this, &pos); ok; ok = range.iteratorNext(&pos)) {
-		Block &b = getBlockRefNoCheck(pos);
-		if (b.id != block_id)
+		if (getBlockRefNoCheck(pos).id != block_id)
 			continue;
 
-		int sum;
-		switch (op) {
-			case O::PROP_SET:
-				b.tile = tile;
-				break;
-			case O::PROP_ADD:
-				// Disallow underflows
-				// Issue: (255 + N) becomes 0 too.
-				sum = tile + (int)b.tile;
-				b.tile = (sum == (int)(uint8_t)sum) * sum;
-				break;
-			default:
-				goto done; // invalid
-		}
-		rect.addInternalPoint(pos);
+		Block &b = getBlockRefForWrite(pos);
+		apply(b);
+		if (b.id == 0 && b.tile == 0)
+			releaseChunkIfEmpty(pos); // air tile reset
+		dirty.mark(pos);
+		modified = true;
 	}
 
 done:
-	if (!rect.isValid())
-		return false;
-
-	modified_rect.addInternalPoint(rect.UpperLeftCorner);
-	modified_rect.addInternalPoint(rect.LowerRightCorner);
-	return true;
+	return modified;
 }
 
 
 const BlockParams *World::getParamsPtr(blockpos_t pos) const
 {
-	auto it = m_params.find(pos);
-	if (it == m_params.end())
-		return nullptr;
-
-	return &it->second;
+	return m_params.find(pos);
 }
 
 
 bool World::getParams(blockpos_t pos, BlockParams *params) const
 {
-	auto it = m_params.find(pos);
-	if (it == m_params.end())
+	const BlockParams *found = m_params.find(pos);
+	if (!found)
 		return false;
 
-	*params = it->second;
+	*params = *found;
 	return true;
 }
 
 
-std::vector<blockpos_t> World::getBlocks(bid_t block_id, std::function<bool(Block &b)> callback) const
+std::vector<blockpos_t> World::getBlocks(bid_t block_id, std::function<bool(Block &b)> callback)
 {
 	std::vector<blockpos_t> found;
+
+	auto it = m_block_index.find(block_id);
+	if (it != m_block_index.end()) {
+		// Already sorted
+		found.reserve(it->second.size());
+		for (u32 packed : it->second) {
+			const blockpos_t pos = unpack_pos(packed);
+			if (!callback || callback(getBlockRefForWrite(pos)))
+				found.emplace_back(pos);
+		}
+		return found;
+	}
+
 	found.reserve(std::hypot(m_size.X, m_size.Y) * 2);
 
+	if (block_id != 0) {
+		// Unallocated chunks cannot contain the requested block
+		u16 indices[WorldChunk::SIZE * WorldChunk::SIZE];
+		for (size_t i = 0; i < m_chunks.size(); ++i) {
+			if (!m_chunks[i])
+				continue;
+
+			const size_t count = blockscan_find_id(m_chunks[i]->blocks,
+				WorldChunk::SIZE * WorldChunk::SIZE, block_id, indices);
+			if (count == 0)
+				continue;
+
+			// The callback may modify the tiles
+			WorldChunk *chunk = callback ? getChunkForWrite(i) : m_chunks[i].get();
+
+			const blockpos_t origin = getChunkOrigin(i);
+			for (size_t n = 0; n < count; ++n) {
+				const blockpos_t pos(
+					origin.X + (indices[n] & WorldChunk::MASK),
+					origin.Y + (indices[n] >> WorldChunk::SIZE_LOG2)
+				);
+				if (!callback || callback(chunk->blocks[indices[n]]))
+					found.emplace_back(pos);
+			}
+		}
+		// Row-major order like before: client and server must select the
+		// same elements (e.g. teleporters) by index.
+		std::sort(found.begin(), found.end(), [] (blockpos_t a, blockpos_t b) {
+			return a.Y < b.Y || (a.Y == b.Y && a.X < b.X);
+		});
+		return found;
+	}
+
 	for (size_t y = 0; y < m_size.Y; ++y)
 	for (size_t x = 0; x < m_size.X; ++x) {
 		blockpos_t pos(x, y);
-		Block &b = getBlockRefNoCheck(pos);
-		if (b.id == block_id) {
-			if (!callback || callback(b))
-				found.emplace_back(pos);
-		}
+		if (getBlockRefNoCheck(pos).id != block_id)
+			continue;
+
+		// Copy to avoid allocations of unmodified air chunks
+		Block b = getBlockRefNoCheck(pos);
+		if (!callback || callback(b))
+			found.emplace_back(pos);
+
+		const Block &ref = getBlockRefNoCheck(pos);
+		if (b.id != ref.id || b.tile != ref.tile || b.bg != ref.bg)
+			setBlockNoCheck(pos, b);
 	}
 
 	return found;
@@ -1,12 +1,18 @@
 #pragma once
 
-#include "core/blockparams.h"
+#include "core/blockparamsmap.h"
+#include "core/dirtymap.h"
 #include "core/macros.h"
 #include "core/types.h"
 #include <rect.h>
-#include <string>
+#include <algorithm> // std::min
+#include <functional>
 #include <map>
-#include <unordered_set>
+#include <memory> // unique_ptr
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 class BlockManager;
 class Packet;
@@ -39,7 +45,6 @@ struct BlockUpdate {
 	void read(Packet &pkt);
 	void write(Packet &pkt) const;
 
-	// for std::unordered_set<> insertions
 	bool operator ==(const BlockUpdate &o) const
 	{
 		// ID check includes FG/BG
@@ -58,14 +63,29 @@ private:
 	const BlockManager *m_mgr;
 };
 
-struct BlockUpdateHash {
-	size_t operator ()(const BlockUpdate &v) const
+/// Pending block changes for networking. Only the last change per position
+/// and layer is kept. Flushed in the order of the first change.
+class BlockUpdateQueue {
+public:
+	void insert(const BlockUpdate &bu);
+
+	inline bool empty() const { return m_order.empty(); }
+	inline size_t size() const { return m_order.size(); }
+	const BlockUpdate &front() const;
+	void pop_front();
+	void clear();
+
+private:
+	static inline u64 getKey(const BlockUpdate &bu)
 	{
 		// 33 bits needs an u64
-		return ((u64)v.isBackground() << 32)
-			| ((u64)v.pos.Y << 16)
-			| ((u64)v.pos.X << 0);
+		return ((u64)bu.isBackground() << 32)
+			| ((u64)bu.pos.Y << 16)
+			| ((u64)bu.pos.X << 0);
 	}
+
+	std::unordered_map<u64, BlockUpdate> m_pending;
+	std::deque<u64> m_order;
 };
 
 struct IWorldMeta {
@@ -94,17 +114,46 @@ struct LobbyWorld : public IWorldMeta {
 
 constexpr u16 PROTOCOL_VERSION_FAKE_DISK = UINT16_MAX;
 
+/// Square area of blocks. Chunks that contain air only are not allocated.
+struct WorldChunk {
+	static constexpr u16 SIZE_LOG2 = 5;
+	static constexpr u16 SIZE = 1 << SIZE_LOG2; // 32x32 blocks
+	static constexpr u16 MASK = SIZE - 1;
+
+	inline Block &at(blockpos_t pos)
+	{
+		return blocks[(pos.Y & MASK) * SIZE + (pos.X & MASK)];
+	}
+	inline const Block &at(blockpos_t pos) const
+	{
+		return blocks[(pos.Y & MASK) * SIZE + (pos.X & MASK)];
+	}
+
+	/// true if all blocks are air (thus the chunk may be freed)
+	bool isEmpty() const;
+
+	Block blocks[SIZE * SIZE];
+
+	/// Read-only placeholder for all unallocated chunks
+	static const WorldChunk EMPTY;
+};
+
 class World {
 public:
 	World(const BlockManager *bmgr, const std::string &id);
 	/// The block data is NOT copied!
 	std::shared_ptr<World> copyNewSkeleton() const;
+	/// Read-only copy of the blocks and params for serialization without
+	/// holding `mutex`. Chunks are shared until the next write (copy-on-write).
+	/// The WorldMeta is shared too and must be accessed under `mutex`.
+	std::shared_ptr<const World> createSnapshot() const;
 	~World();
 
 	enum class Method : u8 {
 		Dummy = 7, // No-op for testing
 		Plain = 41, // Bitmap-alike
-		//CompressionV1,
+		CompressionV1 = 42, // Palette + run-length encoded layers, proto >= 11
+		Chunks = 43, // Blocks are stored per chunk (disk only, see DatabaseWorld)
 		INVALID
 	};
 
@@ -116,6 +165,16 @@ public:
 	void read(Packet &pkt);
 	void write(Packet &pkt, Method method) const;
 
+	/// Content hash of each chunk (blocks and params, tiles excluded).
+	/// Used to detect the chunks that changed since a client cached the world.
+	std::vector<u64> getChunkHashes() const;
+	/// Writes the specified chunks for `readChunks` on an equally sized world
+	void writeChunks(Packet &pkt, const std::vector<size_t> &indices) const;
+	/// Replaces the contained chunks, including their params
+	void readChunks(Packet &pkt);
+	/// Indices of the allocated chunks, nearest to `pos` first
+	std::vector<size_t> getChunksUsedNear(blockpos_t pos) const;
+
 	inline bool isValidPosition(int x, int y) const
 	{
 		return x >= 0 && x < m_size.X
@@ -124,56 +183,142 @@ public:
 
 	bool getBlock(blockpos_t pos, Block *block) const;
 	bool setBlock(blockpos_t pos, const Block block);
-	blockpos_t getBlockPos(const Block *b) const;
+	/// The pointer is invalidated by any block modification
 	const Block *getBlockPtr(blockpos_t pos) const;
 
 	bool checkUpdateBlockNeeded(BlockUpdate &bu);
-	Block *updateBlock(BlockUpdate bu);
+	bool updateBlock(BlockUpdate bu);
 	/// IMPORTANT! 'checkUpdateBlockNeeded' must guard this call!
-	Block &updateBlockNoCheck(BlockUpdate bu);
+	/// Returns the new block
+	Block updateBlockNoCheck(BlockUpdate bu);
 	bool setBlockTiles(PositionRange &range, bid_t block_id, int tile);
 
 	// BlockParams must be changed with updateBlock to ensure correct types
+	/// The pointer is invalidated by any params modification
 	const BlockParams *getParamsPtr(blockpos_t pos) const;
 	bool getParams(blockpos_t pos, BlockParams *params) const;
 
 	const BlockManager *getBlockMgr() const { return m_bmgr; }
 
 	// Result is added when callback is nullptr or returns true
-	std::vector<blockpos_t> getBlocks(bid_t block_id, std::function<bool(Block &b)> callback) const;
-	Block *begin() const { return m_data; };
-	const Block *end() const { return &m_data[m_size.X * m_size.Y]; };
+	// The callback must not change the block ID. Positions are in row-major order.
+	std::vector<blockpos_t> getBlocks(bid_t block_id, std::function<bool(Block &b)> callback);
+	/// Whether the positions of this foreground block are tracked
+	/// (see `getBlocks`, `setBlockTiles`)
+	bool isBlockIndexed(bid_t block_id) const { return m_block_index.count(block_id); }
+
+	/// Chunk-aware iteration over all blocks of the allocated chunks.
+	/// Unallocated chunks consist of air only and are skipped.
+	/// The callback must not change the block ID.
+	/// Callback: void (blockpos_t pos, Block &b)
+	template<typename F>
+	void forEachBlock(F &&callback)
+	{
+		for (size_t i = 0; i < m_chunks.size(); ++i) {
+			if (m_chunks[i])
+				forEachBlockInChunk(i, *getChunkForWrite(i), callback);
+		}
+	}
+	/// Callback: void (blockpos_t pos, const Block &b)
+	template<typename F>
+	void forEachBlock(F &&callback) const
+	{
+		for (size_t i = 0; i < m_chunks.size(); ++i) {
+			if (m_chunks[i])
+				forEachBlockInChunk(i, (const WorldChunk &)*m_chunks[i], callback);
+		}
+	}
+
+	/// Amount of allocated chunks, mainly for statistics
+	size_t getChunkCountUsed() const;
 
 	blockpos_t getSize() const { return m_size; }
 	const WorldMeta &getMeta() const { return *m_meta.get(); }
 	WorldMeta &getMeta() { return *m_meta.get(); }
 
 	mutable std::mutex mutex; // used by Server/Client
-	std::unordered_set<BlockUpdate, BlockUpdateHash> proc_queue; // for networking
+	BlockUpdateQueue proc_queue; // for networking
+
+	void markAllModified() { dirty.markAll(); }
+	DirtyMap dirty; //< used by clients to re-render the modified areas
+
+protected:
+	struct SnapshotTag {};
+	World(const World &source, SnapshotTag);
 
-	static core::rect<u16> make_rect_not_modified()
+	inline size_t getChunkIndex(const blockpos_t pos) const
 	{
-		// Negative width, height
-		return core::rect<u16>(UINT16_MAX, UINT16_MAX, 0, 0);
+		return (pos.Y >> WorldChunk::SIZE_LOG2) * m_chunks_size.X
+			+ (pos.X >> WorldChunk::SIZE_LOG2);
 	}
-	void markAllModified()
+	inline blockpos_t getChunkOrigin(size_t index) const
 	{
-		modified_rect = core::rect<u16>(0, 0, UINT16_MAX, UINT16_MAX);
+		return blockpos_t(
+			(index % m_chunks_size.X) << WorldChunk::SIZE_LOG2,
+			(index / m_chunks_size.X) << WorldChunk::SIZE_LOG2
+		);
 	}
-	core::rect<u16> modified_rect; //< used by clients to re-render the world
 
-protected:
-	inline Block &getBlockRefNoCheck(const blockpos_t pos) const
+	/// Area of the chunk within the world (inclusive corners)
+	inline core::rect<u16> getChunkRect(size_t index) const
+	{
+		const blockpos_t origin = getChunkOrigin(index);
+		return core::rect<u16>(origin.X, origin.Y,
+			std::min<int>(origin.X + WorldChunk::MASK, m_size.X - 1),
+			std::min<int>(origin.Y + WorldChunk::MASK, m_size.Y - 1)
+		);
+	}
+
+	inline const Block &getBlockRefNoCheck(const blockpos_t pos) const
+	{
+		const WorldChunk *chunk = m_chunks[getChunkIndex(pos)].get();
+		return (chunk ? chunk : &WorldChunk::EMPTY)->at(pos);
+	}
+	/// Allocates the chunk if needed. Must be followed by `releaseChunkIfEmpty`
+	/// when air might have been written.
+	Block &getBlockRefForWrite(const blockpos_t pos);
+	/// Unshares the chunk from snapshots. nullptr if not allocated.
+	WorldChunk *getChunkForWrite(size_t index);
+	void setBlockNoCheck(const blockpos_t pos, const Block b);
+	void releaseChunkIfEmpty(const blockpos_t pos);
+
+	/// Must be called on foreground block ID changes outside of `read`
+	void updateBlockIndex(blockpos_t pos, bid_t old_id, bid_t new_id);
+	void rebuildBlockIndex();
+
+	template<typename Chunk, typename F>
+	void forEachBlockInChunk(size_t index, Chunk &chunk, F &callback) const
 	{
-		return m_data[pos.Y * m_size.X + pos.X];
+		const blockpos_t origin = getChunkOrigin(index);
+		// Chunks along the right and bottom edges may exceed the world size
+		const u16 width = std::min<int>(WorldChunk::SIZE, m_size.X - origin.X);
+		const u16 height = std::min<int>(WorldChunk::SIZE, m_size.Y - origin.Y);
+
+		for (u16 y = 0; y < height; ++y)
+		for (u16 x = 0; x < width; ++x) {
+			callback(blockpos_t(origin.X + x, origin.Y + y),
+				chunk.blocks[y * WorldChunk::SIZE + x]);
+		}
 	}
 
+	using ParamsMapper = std::map<bid_t, BlockParams::Type>;
+	using PlainParamsList = std::vector<std::pair<blockpos_t, BlockParams>>;
+
 	void readPlain(Packet &pkt);
+	void readPlainRows(Packet &pkt, u8 version, const ParamsMapper &mapper,
+		size_t y_start, size_t y_end, PlainParamsList &params);
 	void writePlain(Packet &pkt) const;
+	void readCompressionV1(Packet &pkt);
+	void writeCompressionV1(Packet &pkt) const;
 
 	blockpos_t m_size;
 	const BlockManager *m_bmgr;
 	RefCnt<WorldMeta> m_meta;
-	Block *m_data = nullptr;
-	std::map<blockpos_t, BlockParams> m_params;
+	blockpos_t m_chunks_size; //< amount of chunks in X and Y direction
+	/// nullptr: air only. Shared with snapshots, see `getChunkForWrite`.
+	std::vector<std::shared_ptr<WorldChunk>> m_chunks;
+	BlockParamsMap m_params;
+	/// Positions (packed, sorted row-major) of frequently searched block IDs
+	std::map<bid_t, std::vector<u32>> m_block_index;
+	bool m_is_snapshot = false;
 };
@@ -637,10 +637,8 @@ bool SceneGameplay::OnEvent(GameEvent &e)
 			m_dirty_playerlist = true;
 			break;
 		case E::C2G_MAP_UPDATE:
+			// The minimap updates the modified areas on its own
 			m_dirty_world = true;
-
-			if (m_minimap)
-				m_minimap->markDirty();
 			break;
 		case E::C2G_ON_TOUCH_BLOCK:
 			handleOnTouchBlock(e);
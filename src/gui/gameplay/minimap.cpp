@@ -32,6 +32,8 @@ SceneMinimap::~SceneMinimap()
 
 	if (m_overlay_img)
 		m_overlay_img->drop();
+	if (m_blocks_img)
+		m_blocks_img->drop();
 }
 
 void SceneMinimap::draw()
@@ -92,80 +94,94 @@ void SceneMinimap::step(float dtime)
 }
 
 
+static video::SColor get_block_color(const World *world, blockpos_t pos)
+{
+	Block b;
+	if (!world->getBlock(pos, &b))
+		return 0xFF444444; // 2px border
+
+	do {
+		if (b.id == 0)
+			break;
+
+		auto props = g_blockmanager->getProps(b.id);
+		if (!props)
+			return 0xFFFF0000; // default red
+
+		BlockTile tile = props->getTile(b);
+		if (tile.type != BlockDrawType::Solid)
+			break;
+
+		{
+			// Apply visual override
+			const auto vo = tile.visual_override;
+			if (vo.enabled) {
+				b.id = vo.id;
+				b.tile = vo.tile;
+				props = g_blockmanager->getProps(b.id);
+				tile = props->getTile(b);
+			}
+		}
+
+		return props->color;
+	} while (0);
+
+	// No solid block above
+	auto props = g_blockmanager->getProps(b.bg);
+	if (props)
+		return props->color;
+	return 0xFFFF0000; // default red
+}
+
 void SceneMinimap::updateMap()
 {
-	if (!m_is_dirty || !m_is_visible)
+	if (!m_is_visible)
 		return;
-	m_is_dirty = false;
 
 	auto world = m_gui->getClient()->getWorld();
+	if (!world)
+		return;
+
+	// Consume even on full updates to not redraw these areas later
+	std::vector<core::rect<u16>> areas;
+	{
+		SimpleLock lock(world->mutex);
+		areas = world->dirty.consume(DirtyMap::DC_MINIMAP);
+	}
 
 	const size_t width = world->getSize().X + 2 * BORDER;
 	const size_t height = world->getSize().Y + 2 * BORDER;
-
 	core::dimension2du size_new(width, height);
-	auto img = m_gui->driver->createImage(video::ECF_R8G8B8, size_new);
-
-	for (size_t y = 0; y < height; ++y)
-	for (size_t x = 0; x < width; ++x) {
-		Block b;
-		if (!world->getBlock(blockpos_t(x - BORDER, y - BORDER), &b)) {
-			// 2px border
-			img->setPixel(x, y, 0xFF444444);
-			continue;
-		}
-
-		bool have_solid_above = false;
-		do {
-			if (b.id == 0)
-				break;
-
-			auto props = g_blockmanager->getProps(b.id);
-			video::SColor color(0xFFFF0000); // default red
-			BlockTile tile;
-			if (!props)
-				goto set_pixel;
-
-			tile = props->getTile(b);
-			if (tile.type != BlockDrawType::Solid)
-				break;
-
-			{
-				// Apply visual override
-				const auto vo = tile.visual_override;
-				if (vo.enabled) {
-					b.id = vo.id;
-					b.tile = vo.tile;
-					props = g_blockmanager->getProps(b.id);
-					tile = props->getTile(b);
-				}
-			}
-
-			color = props->color;
-set_pixel:
-			img->setPixel(x, y, color);
-			have_solid_above = true;
-		} while (0);
-
 
-		do {
-			if (have_solid_above)
-				break;
+	const bool full_update = m_is_dirty || !m_blocks_img
+		|| m_blocks_img->getDimension() != size_new;
+	if (!full_update && areas.empty())
+		return;
+	m_is_dirty = false;
 
-			auto props = g_blockmanager->getProps(b.bg);
-			video::SColor color(0xFFFF0000); // default red
-			if (props)
-				color = props->color;
+	auto img = m_blocks_img;
+	if (full_update) {
+		if (m_blocks_img)
+			m_blocks_img->drop();
+		img = m_gui->driver->createImage(video::ECF_R8G8B8, size_new);
+		m_blocks_img = img;
 
-			img->setPixel(x, y, color);
-		} while (0);
+		for (size_t y = 0; y < height; ++y)
+		for (size_t x = 0; x < width; ++x)
+			img->setPixel(x, y, get_block_color(world.get(), blockpos_t(x - BORDER, y - BORDER)));
+	} else {
+		// Only the modified areas
+		DEBUGLOG("Minimap: update %zu areas\n", areas.size());
+		for (const auto &area : areas) {
+			for (u16 y = area.UpperLeftCorner.Y; y <= area.LowerRightCorner.Y; ++y)
+			for (u16 x = area.UpperLeftCorner.X; x <= area.LowerRightCorner.X; ++x)
+				img->setPixel(x + BORDER, y + BORDER, get_block_color(world.get(), blockpos_t(x, y)));
+		}
 	}
 
 	m_gui->driver->removeTexture(m_blocks_txt);
 	m_blocks_txt = m_gui->driver->addTexture("&&minimap", img);
 
-	img->drop();
-
 	if (m_imgsize == size_new) {
 		m_blocks_elm->setImage(m_blocks_txt);
 	} else {
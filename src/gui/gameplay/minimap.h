@@ -41,6 +41,7 @@ private:
 
 	core::dimension2du m_imgsize; // texture/image size
 
+	video::IImage *m_blocks_img = nullptr; // kept for partial updates
 	video::ITexture *m_blocks_txt = nullptr;
 	gui::IGUIImage *m_blocks_elm = nullptr;
 
@@ -271,18 +271,17 @@ void SceneWorldRender::drawBlocksInView()
 	}
 
 	/// Whether the rendered blocks changed
-	bool blocks_modified = world->modified_rect.isValid();
-	if (blocks_modified) {
-		core::recti modified = rect_u16_to_recti(world->modified_rect);
+	bool blocks_modified = false;
+	for (const auto &area : world->dirty.consume(DirtyMap::DC_RENDER)) {
+		core::recti modified = rect_u16_to_recti(area);
 		modified.LowerRightCorner += 1; // max pos inclusive
 
-		world->modified_rect = World::make_rect_not_modified();
 		DEBUG_LOG("rect: %d,%d,%d,%d\n",
 			modified.UpperLeftCorner.X, modified.UpperLeftCorner.Y,
 			modified.LowerRightCorner.X, modified.LowerRightCorner.Y
 		);
 
-		blocks_modified = modified.isRectCollided(m_drawn_rect);
+		blocks_modified |= modified.isRectCollided(m_drawn_rect);
 	}
 
 	DEBUG_LOG("draw: modified=%d, all_visible=%d\n", blocks_modified, all_visible);
@@ -460,9 +459,10 @@ void SceneWorldRender::drawBlockParams(BlockDrawData &bdd)
 {
 	if (!g_blockmanager->isHardcoded()) {
 		TileCacheManager &tcache = m_gui->getClient()->getTileCacheMgr();
-		const Block *b = bdd.world->getBlockPtr(bdd.pos);
+		Block b; // unmodified, in contrast to bdd.b
+		bdd.world->getBlock(bdd.pos, &b);
 
-		const TileCacheEntry entry = tcache.getOrCache(b);
+		const TileCacheEntry entry = tcache.getOrCache(bdd.pos, b);
 		if (entry.overlay.empty())
 			return;
 
@@ -21,6 +21,7 @@
 
 
 void unittest(int gui_test_nr);
+void benchmark_server(size_t peers_idle, size_t peers_active);
 
 extern BlockManager *g_blockmanager;
 
@@ -62,21 +63,33 @@ static int run_client()
 	return EXIT_SUCCESS;
 }
 
-static int run_server()
+static int run_server(size_t max_peers = 0, float tick_rate = 0)
 {
-	Server server(&shutdown_requested);
+	Server server(&shutdown_requested, max_peers);
+	if (tick_rate > 0)
+		server.tick_interval = 1.0f / tick_rate;
 	auto t_last = std::chrono::steady_clock::now();
+	auto t_next = t_last;
 	while (!shutdown_requested) {
 		float dtime;
+		auto t_now = std::chrono::steady_clock::now();
 		{
 			// Measure precise timings
-			auto t_now = std::chrono::steady_clock::now();
 			dtime = std::chrono::duration<float>(t_now - t_last).count();
 			t_last = t_now;
 		}
 
 		server.step(dtime);
-		sleep_ms(100);
+
+		// Fixed rate. Skip the missed ticks after an overrun.
+		const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<float>(server.tick_interval));
+		if (t_now >= t_next)
+			t_next += interval;
+		if (t_next < t_now)
+			t_next = t_now + interval;
+
+		server.waitForTick(t_next); // or earlier for new packets
 	}
 
 	return EXIT_SUCCESS;
@@ -143,6 +156,19 @@ static int parse_args(int argc, char *argv[])
 		unittest(gui_test_nr);
 		return EXIT_SUCCESS;
 	}
+	if (strcmp(argv[1], "--benchmark") == 0) {
+		// Server::step under load. Default: 2000 idle, 200 active peers
+		g_blockmanager->doPackRegistration();
+		size_t peers_idle = argc >= 3 ? atoi(argv[2]) : 2000;
+		size_t peers_active = argc >= 4 ? atoi(argv[3]) : 200;
+		try {
+			benchmark_server(peers_idle, peers_active);
+			return EXIT_SUCCESS;
+		} catch (std::exception &e) {
+			fprintf(stderr, "%s\n", e.what());
+		}
+		return EXIT_FAILURE;
+	}
 	if (strcmp(argv[1], "--decompress") == 0) {
 		if (argc != 3) {
 			fprintf(stderr, "%s--decompress FILEPATH\n", MISSING_ARGS);
@@ -158,7 +184,13 @@ static int parse_args(int argc, char *argv[])
 	}
 	if (strcmp(argv[1], "--server") == 0) {
 		// Dedicated server
-		return run_server();
+		size_t max_peers = 0;
+		if (argc >= 3)
+			max_peers = atoi(argv[2]);
+		float tick_rate = 0;
+		if (argc >= 4)
+			tick_rate = atof(argv[3]);
+		return run_server(max_peers, tick_rate);
 	}
 	if (strcmp(argv[1], "--setrole") == 0) {
 		if (argc != 4) {
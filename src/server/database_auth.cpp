@@ -7,7 +7,11 @@
 constexpr int AUTH_DB_VERSION_LATEST = 1;
 
 
-DatabaseAuth::DatabaseAuth() : Database()
+DatabaseAuth::DatabaseAuth() :
+	Database(),
+	m_account_cache(500),
+	m_ban_cache(2000),
+	m_friends_cache(200)
 {
 	for (size_t i = 0; i < STMT_MAX; ++i)
 		m_stmt[i] = nullptr;
@@ -154,7 +158,8 @@ bool DatabaseAuth::tryOpen(const char *filepath)
 		"VALUES (?, ?, ?, ?)"
 	);
 	PREPARE(STMT_F2B_READ,
-		"SELECT * FROM `fail2ban` WHERE `affected` = ? AND `context` = ? LIMIT 1"
+		"SELECT * FROM `fail2ban` WHERE `affected` = ? AND `context` = ? "
+		"ORDER BY `expiry` DESC LIMIT 1"
 	);
 	PREPARE(STMT_F2B_CLEANUP,
 		"DELETE FROM `fail2ban` WHERE `expiry` <= ?"
@@ -197,6 +202,18 @@ void DatabaseAuth::close()
 		m_stmt[i] = nullptr;
 	}
 
+	{
+		AuthCacheStats stats = getCacheStats();
+		printf("DatabaseAuth: cache hits/misses: accounts=%zu/%zu, bans=%zu/%zu, friends=%zu/%zu\n",
+			stats.accounts.hits, stats.accounts.misses,
+			stats.bans.hits, stats.bans.misses,
+			stats.friends.hits, stats.friends.misses
+		);
+	}
+	m_account_cache.clear();
+	m_ban_cache.clear();
+	m_friends_cache.clear();
+
 	Database::close();
 }
 
@@ -284,6 +301,11 @@ bool DatabaseAuth::load(const std::string &name, AuthAccount *auth)
 	if (!m_database || !auth)
 		return false;
 
+	if (const AuthAccount *cached = m_account_cache.get(name)) {
+		*auth = *cached;
+		return true;
+	}
+
 	auto s = m_stmt[STMT_AUTH_READ];
 	custom_bind_string(s, 1, name);
 
@@ -303,6 +325,8 @@ bool DatabaseAuth::load(const std::string &name, AuthAccount *auth)
 	bool good = ok("auth_read", sqlite3_step(s));
 	sqlite3_reset(s);
 
+	if (good)
+		m_account_cache.set(name, *auth);
 	return good;
 }
 
@@ -331,6 +355,10 @@ WRITE_ACTION({
 	sqlite3_reset(m_stmt_end);
 })
 
+	if (good)
+		m_account_cache.set(auth.name, auth);
+	else
+		m_account_cache.erase(auth.name);
 	return good;
 }
 
@@ -373,6 +401,12 @@ WRITE_ACTION({
 	ok("auth_set_pw_r", sqlite3_reset(s));
 })
 
+	if (AuthAccount *cached = m_account_cache.get(name)) {
+		if (good)
+			cached->password = hash;
+		else
+			m_account_cache.erase(name);
+	}
 	return good;
 }
 
@@ -381,6 +415,11 @@ bool DatabaseAuth::listFriends(const std::string &name, std::vector<AuthFriend>
 	if (!m_database || !friends)
 		return false;
 
+	if (const auto *cached = m_friends_cache.get(name)) {
+		*friends = *cached;
+		return true;
+	}
+
 	friends->clear();
 	auto s = m_stmt[STMT_FRIENDS_LIST];
 	custom_bind_string(s, 1, name);
@@ -406,6 +445,8 @@ bool DatabaseAuth::listFriends(const std::string &name, std::vector<AuthFriend>
 	good = ok("friends_list", sqlite3_errcode(m_database));
 	sqlite3_reset(s);
 
+	if (good)
+		m_friends_cache.set(name, *friends);
 	return good;
 }
 
@@ -419,6 +460,9 @@ bool DatabaseAuth::setFriend(AuthFriend f)
 	if (f.p1.name > f.p2.name)
 		std::swap(f.p1, f.p2);
 
+	m_friends_cache.erase(f.p1.name);
+	m_friends_cache.erase(f.p2.name);
+
 WRITE_ACTION({
 	sqlite3_stmt *s = m_stmt[STMT_FRIENDS_WRITE];
 	int i = 1;
@@ -444,6 +488,9 @@ bool DatabaseAuth::removeFriend(const std::string &name1, const std::string &nam
 
 	bool swap = name1 > name2;
 
+	m_friends_cache.erase(name1);
+	m_friends_cache.erase(name2);
+
 WRITE_ACTION({
 	auto s = m_stmt[STMT_FRIENDS_REMOVE];
 	int i = 1;
@@ -459,6 +506,14 @@ WRITE_ACTION({
 
 static_assert(sizeof(time_t) == 8, "Need 64-bit time_t");
 
+static std::string ban_cache_key(const std::string &affected, const std::string &context)
+{
+	std::string key = affected;
+	key.push_back('\0');
+	key.append(context);
+	return key;
+}
+
 bool DatabaseAuth::ban(const AuthBanEntry &entry)
 {
 	if (!m_database)
@@ -486,6 +541,9 @@ bool DatabaseAuth::ban(const AuthBanEntry &entry)
 	sqlite3_step(m_stmt_end);
 	sqlite3_reset(m_stmt_end);
 
+	// Might extend the cached ban
+	m_ban_cache.erase(ban_cache_key(entry.affected, entry.context));
+
 	if (good) {
 		printf("Server: Banned %s (context='%s') until %llu\n",
 			entry.affected.c_str(), entry.context.c_str(), (unsigned long long)entry.expiry
@@ -500,31 +558,46 @@ bool DatabaseAuth::getBanRecord(const std::string &affected, const std::string &
 	if (!m_database)
 		return false;
 
-	auto s = m_stmt[STMT_F2B_READ];
-	custom_bind_string(s, 1, affected);
-	custom_bind_string(s, 2, context);
-
 	const time_t time_now = time(nullptr);
-	bool good = false;
-	while (sqlite3_step(s) == SQLITE_ROW) {
-		int i = 0;
-		int64_t expiry = sqlite3_column_int64(s, i++);
-		if (expiry <= time_now)
-			continue; // expired
-
-		good = true;
-		// Always find the longest lasting ban record.
-		if (entry && expiry > entry->expiry) {
-			entry->expiry   = expiry;
-			entry->affected = (const char *)sqlite3_column_text(s, i++);
-			entry->context  = (const char *)sqlite3_column_text(s, i++);
-			entry->comment  = (const char *)sqlite3_column_text(s, i++);
+	const std::string key = ban_cache_key(affected, context);
+	const AuthBanEntry *longest = m_ban_cache.get(key);
+
+	if (!longest) {
+		auto s = m_stmt[STMT_F2B_READ];
+		custom_bind_string(s, 1, affected);
+		custom_bind_string(s, 2, context);
+
+		AuthBanEntry found; // expiry = 0: no active ban
+		while (sqlite3_step(s) == SQLITE_ROW) {
+			int i = 0;
+			int64_t expiry = sqlite3_column_int64(s, i++);
+			if (expiry <= time_now)
+				continue; // expired
+
+			// Always find the longest lasting ban record.
+			if (expiry > found.expiry) {
+				found.expiry   = expiry;
+				found.affected = (const char *)sqlite3_column_text(s, i++);
+				found.context  = (const char *)sqlite3_column_text(s, i++);
+				found.comment  = (const char *)sqlite3_column_text(s, i++);
+			}
 		}
+
+		bool good = ok("f2b_ban", sqlite3_errcode(m_database));
+		sqlite3_reset(s);
+		if (!good)
+			return false;
+
+		longest = m_ban_cache.set(key, std::move(found));
 	}
 
-	ok("f2b_ban", sqlite3_errcode(m_database));
-	sqlite3_reset(s);
-	return good;
+	// Once the longest ban expired, there is none left until `ban` is called.
+	if (longest->expiry <= time_now)
+		return false;
+
+	if (entry && longest->expiry > entry->expiry)
+		*entry = *longest;
+	return true;
 }
 
 bool DatabaseAuth::cleanupBans()
@@ -547,6 +620,20 @@ bool DatabaseAuth::cleanupBans()
 	return good;
 }
 
+AuthCacheStats DatabaseAuth::getCacheStats() const
+{
+	AuthCacheStats stats;
+	auto fill = [] (AuthCacheStats::Counters &dst, const auto &cache) {
+		dst.hits = cache.hits;
+		dst.misses = cache.misses;
+		dst.size = cache.size();
+	};
+	fill(stats.accounts, m_account_cache);
+	fill(stats.bans, m_ban_cache);
+	fill(stats.friends, m_friends_cache);
+	return stats;
+}
+
 bool DatabaseAuth::logNow(AuthLogEntry entry)
 {
 	entry.timestamp = time(nullptr);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "database.h"
+#include "core/lrucache.h"
 #include <ctime>
 #include <vector> // friends
 
@@ -51,6 +52,17 @@ struct AuthLogEntry {
 	std::string text;
 };
 
+struct AuthCacheStats {
+	struct Counters {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t size = 0;
+	};
+	Counters accounts, bans, friends;
+};
+
+/// Reads are served from write-through caches where possible.
+/// The database file must not be modified by other processes.
 class DatabaseAuth : public Database {
 public:
 	DatabaseAuth();
@@ -84,6 +96,8 @@ public:
 
 	bool logNow(AuthLogEntry entry);
 
+	AuthCacheStats getCacheStats() const;
+
 
 private:
 	enum {
@@ -111,4 +125,9 @@ private:
 	sqlite3_stmt *m_stmt[STMT_MAX];
 
 	std::string m_unique_salt;
+
+	LRUCache<std::string, AuthAccount> m_account_cache;
+	/// Key: affected + '\0' + context. Value: longest ban or expiry = 0
+	LRUCache<std::string, AuthBanEntry> m_ban_cache;
+	LRUCache<std::string, std::vector<AuthFriend>> m_friends_cache;
 };
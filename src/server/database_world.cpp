@@ -1,14 +1,20 @@
 #include "database_world.h"
+#include "core/logger.h"
 #include "core/packet.h"
+#include "core/threadpool.h"
 #include "core/worldmeta.h"
+#include <cmath> // std::sqrt
 #include <sqlite3.h>
+#include <unordered_map>
+
+static Logger logger("DatabaseWorld", LL_INFO);
 
 DatabaseWorld::~DatabaseWorld()
 {
 	close();
 }
 
-static int cb_get_boolean(void *have_sqrt, int count, char **values, char **labels)
+static int cb_get_boolean(void *result, int count, char **values, char **labels)
 {
 	(void)count;
 	(void)labels;
@@ -18,41 +24,44 @@ static int cb_get_boolean(void *have_sqrt, int count, char **values, char **labe
 		printf("%d | %s \t| %s\n", i, labels[i], values[i]);
 #endif
 
-	*(bool *)have_sqrt = (values[0][0] == '1');
+	*(bool *)result = (values[0][0] == '1');
 	return 0;
 }
 
-static void reg_sqrt(sqlite3_context *context, int argc, sqlite3_value **argv)
-{
-	float value;
-	if (argc < 1) {
-		sqlite3_result_null(context);
-		return;
+/// Derived columns of `worlds` for the lobby queries
+struct WorldDataInfo {
+	/// @param data     `worlds`.`data`
+	/// @param chunks_size Total size of the `world_chunks` data
+	WorldDataInfo(const u8 *data, size_t length, size_t chunks_size, blockpos_t world_size)
+	{
+		// O E f w METHOD VER CK CK
+		const u8 method = length >= 5 ? data[4] : 0;
+		u8 version = length >= 6 ? data[5] : 0;
+		const bool is_chunked = method == (u8)World::Method::Chunks;
+		if (is_chunked)
+			version = 1; // World::writeChunks
+
+		data_size = length + chunks_size;
+		format_version = method << 8 | version;
+
+		// Skip non-compressed worlds (version < 5) --> do a fuzzy check.
+		const bool is_compressed = is_chunked || (length >= 8 && version >= 5);
+		if (is_compressed)
+			featured_score = data_size / std::sqrt((double)world_size.X * world_size.Y);
 	}
 
-	value = sqlite3_value_double(argv[0]);
-	sqlite3_result_double(context, std::sqrt(value));
-}
+	size_t data_size;
+	int format_version; // World::Method << 8 | method version
+	double featured_score = 0; // bytes per block edge length, > 15 is featured
+};
 
 bool DatabaseWorld::tryOpen(const char *filepath)
 {
 	if (!Database::tryOpen(filepath))
 		return false;
 
-	// Additional compatibility for amalgamation builds when -DSQLITE_ENABLE_MATH_FUNCTIONS is
-	// not specified, and thus missing the 'sqrt' function.
-	bool have_sqrt = false;
-	sqlite3_exec(m_database,
-		// https://stackoverflow.com/a/62574590
-		"select exists(select 1 from pragma_function_list where name='sqrt');",
-		cb_get_boolean, &have_sqrt, nullptr);
-	if (!have_sqrt) {
-		fprintf(stderr, "Manual registration of sqlite3 function 'sqrt'.\n");
-		// Register the function
-		sqlite3_create_function(m_database, "sqrt", 1, SQLITE_UTF8,
-			nullptr, reg_sqrt, nullptr, nullptr);
-	}
-
+	// Reads must not be blocked by `WorldSaver` (separate connection)
+	enableWAL();
 
 	// Thanks "DB Browser for SQLite"
 	bool good = ok("create", sqlite3_exec(m_database,
@@ -66,28 +75,116 @@ bool DatabaseWorld::tryOpen(const char *filepath)
 		"`visibility`   INTEGER,"
 		"`player_flags` BLOB,"
 		"`data`   BLOB,"
+		"`data_size`      INTEGER,"
+		"`format_version` INTEGER,"
+		"`featured_score` REAL,"
 		"PRIMARY KEY(`id`)"
 		")",
 		nullptr, nullptr, nullptr));
 
+	bool have_columns = false;
+	sqlite3_exec(m_database,
+		"SELECT EXISTS(SELECT 1 FROM pragma_table_info('worlds') WHERE name='featured_score');",
+		cb_get_boolean, &have_columns, nullptr);
+	if (!have_columns) {
+		// Migration: filled by `backfillDataInfo`
+		good &= ok("add_columns", sqlite3_exec(m_database,
+			"ALTER TABLE `worlds` ADD COLUMN `data_size` INTEGER;"
+			"ALTER TABLE `worlds` ADD COLUMN `format_version` INTEGER;"
+			"ALTER TABLE `worlds` ADD COLUMN `featured_score` REAL;",
+			nullptr, nullptr, nullptr));
+	}
+
+	good &= ok("create_indices", sqlite3_exec(m_database,
+		"CREATE INDEX IF NOT EXISTS `worlds_owner` ON `worlds` (`owner`);"
+		"CREATE INDEX IF NOT EXISTS `worlds_visibility` ON `worlds` (`visibility`, `featured_score`);",
+		nullptr, nullptr, nullptr));
+
+	// Independently compressed chunks (`World::writeChunks`) of the worlds
+	// with `World::Method::Chunks`. Older worlds are migrated on save.
+	good &= ok("create_chunks", sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `world_chunks` ("
+		"`world_id` TEXT,"
+		"`cx`       INTEGER,"
+		"`cy`       INTEGER,"
+		"`version`  INTEGER,"
+		"`data`     BLOB,"
+		"PRIMARY KEY(`world_id`, `cx`, `cy`)"
+		")",
+		nullptr, nullptr, nullptr));
+
+	// Block updates since the last checkpoint, in insertion order (rowid)
+	good &= ok("create_journal", sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `world_journal` ("
+		"`world_id` TEXT,"
+		"`data`     BLOB"
+		");"
+		"CREATE INDEX IF NOT EXISTS `world_journal_id` ON `world_journal` (`world_id`);",
+		nullptr, nullptr, nullptr));
+
+	// Blocks of the owner's last /save, restored by /load.
+	// `worlds`.`data` is the crash-recovery checkpoint.
+	good &= ok("create_saved", sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `world_saved` ("
+		"`world_id` TEXT,"
+		"`width`    INTEGER,"
+		"`height`   INTEGER,"
+		"`data`     BLOB,"
+		"PRIMARY KEY(`world_id`)"
+		")",
+		nullptr, nullptr, nullptr));
+
 
 	good &= ok("read", sqlite3_prepare_v2(m_database,
 		"SELECT * FROM `worlds` WHERE `id` = ? LIMIT 1",
 		-1, &m_stmt_read, nullptr));
 	good &= ok("write", sqlite3_prepare_v2(m_database,
 		"REPLACE INTO `worlds` "
-		"(`id`, `width`, `height`, `owner`, `title`, `plays`, `visibility`, `player_flags`, `data`) "
-		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+		"(`id`, `width`, `height`, `owner`, `title`, `plays`, `visibility`, `player_flags`, `data`, "
+		"`data_size`, `format_version`, `featured_score`) "
+		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
 		-1, &m_stmt_write, nullptr));
+	good &= ok("chunks_read", sqlite3_prepare_v2(m_database,
+		"SELECT `data` FROM `world_chunks` WHERE `world_id` = ?",
+		-1, &m_stmt_chunks_read, nullptr));
+	good &= ok("chunks_versions", sqlite3_prepare_v2(m_database,
+		"SELECT `cx`, `cy`, `version`, length(`data`) FROM `world_chunks` WHERE `world_id` = ?",
+		-1, &m_stmt_chunks_versions, nullptr));
+	good &= ok("chunks_write", sqlite3_prepare_v2(m_database,
+		"REPLACE INTO `world_chunks` (`world_id`, `cx`, `cy`, `version`, `data`) "
+		"VALUES (?, ?, ?, ?, ?)",
+		-1, &m_stmt_chunks_write, nullptr));
+	good &= ok("chunks_remove", sqlite3_prepare_v2(m_database,
+		"DELETE FROM `world_chunks` WHERE `world_id` = ? AND `cx` = ? AND `cy` = ?",
+		-1, &m_stmt_chunks_remove, nullptr));
+	good &= ok("journal_read", sqlite3_prepare_v2(m_database,
+		"SELECT `data` FROM `world_journal` WHERE `world_id` = ? ORDER BY `rowid`",
+		-1, &m_stmt_journal_read, nullptr));
+	good &= ok("journal_add", sqlite3_prepare_v2(m_database,
+		"INSERT INTO `world_journal` (`world_id`, `data`) VALUES (?, ?)",
+		-1, &m_stmt_journal_add, nullptr));
+	good &= ok("journal_clear", sqlite3_prepare_v2(m_database,
+		"DELETE FROM `world_journal` WHERE `world_id` = ?",
+		-1, &m_stmt_journal_clear, nullptr));
+	good &= ok("saved_read", sqlite3_prepare_v2(m_database,
+		"SELECT `width`, `height`, `data` FROM `world_saved` WHERE `world_id` = ?",
+		-1, &m_stmt_saved_read, nullptr));
+	good &= ok("saved_write", sqlite3_prepare_v2(m_database,
+		"REPLACE INTO `world_saved` (`world_id`, `width`, `height`, `data`) "
+		"VALUES (?, ?, ?, ?)",
+		-1, &m_stmt_saved_write, nullptr));
 	good &= ok("by_player", sqlite3_prepare_v2(m_database,
 		"SELECT `id`, `width`, `height`, `title`, `plays`, `visibility` "
 		"FROM `worlds` WHERE `owner` = ?",
 		-1, &m_stmt_by_player, nullptr));
 	good &= ok("featured", sqlite3_prepare_v2(m_database,
-		"SELECT `id`, `width`, `height`, `title`, `plays`, `visibility`, `owner`, `data` "
-		"FROM `worlds` WHERE `visibility` >= 0 AND length(`data`) > 15 * sqrt(`width` * `height`)",
+		"SELECT `id`, `width`, `height`, `title`, `plays`, `visibility`, `owner` "
+		"FROM `worlds` WHERE `visibility` >= 0 AND `featured_score` > 15",
 		-1, &m_stmt_featured, nullptr));
 
+	if (good)
+		good &= backfillDataInfo();
+
 	return good;
 }
 
@@ -98,6 +195,15 @@ void DatabaseWorld::close()
 
 	ok("~read", sqlite3_finalize(m_stmt_read));
 	ok("~write", sqlite3_finalize(m_stmt_write));
+	ok("~chunks_read", sqlite3_finalize(m_stmt_chunks_read));
+	ok("~chunks_versions", sqlite3_finalize(m_stmt_chunks_versions));
+	ok("~chunks_write", sqlite3_finalize(m_stmt_chunks_write));
+	ok("~chunks_remove", sqlite3_finalize(m_stmt_chunks_remove));
+	ok("~journal_read", sqlite3_finalize(m_stmt_journal_read));
+	ok("~journal_add", sqlite3_finalize(m_stmt_journal_add));
+	ok("~journal_clear", sqlite3_finalize(m_stmt_journal_clear));
+	ok("~saved_read", sqlite3_finalize(m_stmt_saved_read));
+	ok("~saved_write", sqlite3_finalize(m_stmt_saved_write));
 	ok("~by_player", sqlite3_finalize(m_stmt_by_player));
 	ok("~featured", sqlite3_finalize(m_stmt_featured));
 
@@ -109,7 +215,7 @@ static int custom_bind_string(sqlite3_stmt *s, int col, const std::string &text)
 	return sqlite3_bind_text(s, col, text.c_str(), text.size(), nullptr);
 }
 
-bool DatabaseWorld::load(World *world)
+bool DatabaseWorld::load(World *world, bool owner_save)
 {
 	if (!m_database)
 		return false;
@@ -163,50 +269,301 @@ bool DatabaseWorld::load(World *world)
 	bool good = ok("read", sqlite3_errcode(m_database));
 	sqlite3_reset(s);
 
+	if (owner_save) {
+		s = m_stmt_saved_read;
+		custom_bind_string(s, 1, meta.id);
+		const bool found = sqlite3_step(s) == SQLITE_ROW;
+		if (found) {
+			size.X = sqlite3_column_int(s, 0);
+			size.Y = sqlite3_column_int(s, 1);
+			world->createDummy(size);
+
+			const void *blob = sqlite3_column_blob(s, 2);
+			const size_t len = sqlite3_column_bytes(s, 2);
+			Packet pkt(blob, len);
+			pkt.data_version = PROTOCOL_VERSION_FAKE_DISK;
+			world->read(pkt);
+			sqlite3_step(s);
+		}
+		good &= ok("saved_read", sqlite3_errcode(m_database));
+		sqlite3_reset(s);
+
+		if (found)
+			return good;
+		// Never saved by the owner: latest checkpoint without the journal
+	}
+
+	// Chunked storage (empty for older worlds)
+	s = m_stmt_chunks_read;
+	custom_bind_string(s, 1, meta.id);
+	while (sqlite3_step(s) == SQLITE_ROW) {
+		const void *blob = sqlite3_column_blob(s, 0);
+		const size_t len = sqlite3_column_bytes(s, 0);
+		Packet pkt(blob, len);
+		pkt.data_version = PROTOCOL_VERSION_FAKE_DISK;
+		world->readChunks(pkt);
+	}
+	good &= ok("chunks_read", sqlite3_errcode(m_database));
+	sqlite3_reset(s);
+
+	if (owner_save)
+		return good;
+
+	// Replay the edits since the last checkpoint
+	s = m_stmt_journal_read;
+	custom_bind_string(s, 1, meta.id);
+	size_t count = 0;
+	while (sqlite3_step(s) == SQLITE_ROW) {
+		const void *blob = sqlite3_column_blob(s, 0);
+		const size_t len = sqlite3_column_bytes(s, 0);
+		Packet pkt(blob, len);
+		pkt.data_version = PROTOCOL_VERSION_FAKE_DISK;
+
+		try {
+			while (pkt.getRemainingBytes() > 0) {
+				BlockUpdate bu(world->getBlockMgr());
+				bu.read(pkt);
+				world->updateBlock(bu);
+				count++;
+			}
+		} catch (std::exception &e) {
+			logger(LL_ERROR, "Journal of world %s: %s", meta.id.c_str(), e.what());
+		}
+	}
+	good &= ok("journal_read", sqlite3_errcode(m_database));
+	sqlite3_reset(s);
+
+	if (count > 0)
+		logger(LL_INFO, "Replayed %zu journal entries of world %s", count, meta.id.c_str());
+
 	return good;
 }
 
+void WorldSaveData::capture(const World *world)
+{
+	// Keep the lock short: serialization happens on the snapshot
+	SimpleLock lock(world->mutex);
+
+	const auto &meta = world->getMeta();
+	id = meta.id;
+	owner = meta.owner;
+	title = meta.title;
+	plays = meta.plays;
+	is_public = meta.is_public;
+	meta.writePlayerFlags(p_flags);
+
+	snapshot = world->createSnapshot();
+}
+
 bool DatabaseWorld::save(const World *world)
+{
+	WorldSaveData data;
+	data.capture(world);
+	return save({ &data });
+}
+
+bool DatabaseWorld::save(const std::vector<WorldSaveData *> &batch,
+	const std::vector<WorldJournalData *> &journal)
 {
 	if (!m_database)
 		return false;
 
-	SimpleLock lock(world->mutex);
-
 	// https://www.sqlite.org/lang_transaction.html
 	sqlite3_step(m_stmt_begin);
 	sqlite3_reset(m_stmt_begin);
 
-	const auto &meta = world->getMeta();
+	bool good = true;
+	for (const WorldSaveData *data : batch) {
+		size_t chunks_size = 0;
+		good &= saveChunks(data->id, *data->snapshot, &chunks_size);
+
+		// IMPORTANT: slite3_bind_*(...) does NOT copy the data.
+		// The packets must be alive until sqlite3_step(...)
+		Packet p_world;
+		p_world.data_version = PROTOCOL_VERSION_FAKE_DISK;
+		data->snapshot->write(p_world, World::Method::Chunks);
+
+		auto s = m_stmt_write;
+		custom_bind_string(s, 1, data->id);
+		sqlite3_bind_int(s, 2, data->snapshot->getSize().X);
+		sqlite3_bind_int(s, 3, data->snapshot->getSize().Y);
+		custom_bind_string(s, 4, data->owner);
+		custom_bind_string(s, 5, data->title);
+		sqlite3_bind_int(s, 6, data->plays);
+		sqlite3_bind_int(s, 7, data->is_public ? 1 : 0);
+		sqlite3_bind_blob(s, 8, data->p_flags.data(), data->p_flags.size(), nullptr);
+		sqlite3_bind_blob(s, 9, p_world.data(), p_world.size(), nullptr);
+
+		WorldDataInfo info(p_world.data(), p_world.size(), chunks_size, data->snapshot->getSize());
+		sqlite3_bind_int64(s, 10, info.data_size);
+		sqlite3_bind_int(s, 11, info.format_version);
+		sqlite3_bind_double(s, 12, info.featured_score);
+
+		good &= ok("save_s", sqlite3_step(s));
+		ok("save_r", sqlite3_reset(s));
+
+		// Contained in the new data
+		s = m_stmt_journal_clear;
+		custom_bind_string(s, 1, data->id);
+		good &= ok("journal_clear_s", sqlite3_step(s));
+		ok("journal_clear_r", sqlite3_reset(s));
+
+		if (!data->owner_snapshot)
+			continue;
 
-	auto s = m_stmt_write;
-	custom_bind_string(s, 1, meta.id);
-	sqlite3_bind_int(s, 2, world->getSize().X);
-	sqlite3_bind_int(s, 3, world->getSize().Y);
-	custom_bind_string(s, 4, meta.owner);
-	custom_bind_string(s, 5, meta.title);
-	sqlite3_bind_int(s, 6, meta.plays);
-	sqlite3_bind_int(s, 7, meta.is_public ? 1 : 0);
-
-	// IMPORTANT: slite3_bind_*(...) does NOT copy the data.
-	// The packets must be alive until sqlite3_step(...)
-	Packet p_flags;
-	meta.writePlayerFlags(p_flags);
-	sqlite3_bind_blob(s, 8, p_flags.data(), p_flags.size(), nullptr);
+		const World &saved = *data->owner_snapshot;
+		Packet p_saved;
+		p_saved.data_version = PROTOCOL_VERSION_FAKE_DISK;
+		saved.write(p_saved, World::Method::CompressionV1);
+
+		s = m_stmt_saved_write;
+		custom_bind_string(s, 1, data->id);
+		sqlite3_bind_int(s, 2, saved.getSize().X);
+		sqlite3_bind_int(s, 3, saved.getSize().Y);
+		sqlite3_bind_blob(s, 4, p_saved.data(), p_saved.size(), nullptr);
+		good &= ok("saved_write_s", sqlite3_step(s));
+		ok("saved_write_r", sqlite3_reset(s));
+	}
 
-	Packet p_world;
-	p_world.data_version = PROTOCOL_VERSION_FAKE_DISK;
-	world->write(p_world, World::Method::Plain);
-	sqlite3_bind_blob(s, 9, p_world.data(), p_world.size(), nullptr);
+	for (const WorldJournalData *data : journal) {
+		auto s = m_stmt_journal_add;
+		custom_bind_string(s, 1, data->id);
+		sqlite3_bind_blob(s, 2, data->records.data(), data->records.size(), nullptr);
 
-	bool good = ok("save_s", sqlite3_step(s));
-	ok("save_r", sqlite3_reset(s));
+		good &= ok("journal_add_s", sqlite3_step(s));
+		ok("journal_add_r", sqlite3_reset(s));
+	}
 
 	sqlite3_step(m_stmt_end);
 	sqlite3_reset(m_stmt_end);
 	return good;
 }
 
+bool DatabaseWorld::saveChunks(const std::string &id, const World &world, size_t *total_size)
+{
+	// Key: cx << 16 | cy. Value: version, size
+	std::unordered_map<u32, std::pair<sqlite3_int64, size_t>> stored;
+
+	auto s = m_stmt_chunks_versions;
+	custom_bind_string(s, 1, id);
+	while (sqlite3_step(s) == SQLITE_ROW) {
+		const u32 key = (u32)sqlite3_column_int(s, 0) << 16 | (u16)sqlite3_column_int(s, 1);
+		stored[key] = { sqlite3_column_int64(s, 2), sqlite3_column_int(s, 3) };
+	}
+	bool good = ok("chunks_versions", sqlite3_errcode(m_database));
+	sqlite3_reset(s);
+
+	const std::vector<u64> hashes = world.getChunkHashes();
+	const size_t chunks_x = (world.getSize().X + WorldChunk::MASK) >> WorldChunk::SIZE_LOG2;
+
+	struct ChangedChunk {
+		size_t index;
+		sqlite3_int64 version;
+		Packet pkt;
+	};
+	std::vector<ChangedChunk> changed;
+
+	for (size_t index : world.getChunksUsedNear(blockpos_t(0, 0))) {
+		const u16 cx = index % chunks_x;
+		const u16 cy = index / chunks_x;
+		// The serialized chunk contains its index
+		const sqlite3_int64 version = hashes[index] ^ ((u64)index * 0x9E3779B97F4A7C15ULL);
+
+		auto it = stored.find((u32)cx << 16 | cy);
+		if (it != stored.end()) {
+			const bool unchanged = it->second.first == version;
+			if (unchanged)
+				*total_size += it->second.second;
+			stored.erase(it);
+			if (unchanged)
+				continue;
+		}
+
+		changed.push_back({ index, version, Packet() });
+	}
+
+	// Compression takes most of the time. The snapshot is read-only.
+	ThreadPool::getShared().run(changed.size(), [&] (size_t i) {
+		Packet &pkt = changed[i].pkt;
+		pkt.data_version = PROTOCOL_VERSION_FAKE_DISK;
+		world.writeChunks(pkt, { changed[i].index });
+	});
+
+	for (const ChangedChunk &chunk : changed) {
+		s = m_stmt_chunks_write;
+		custom_bind_string(s, 1, id);
+		sqlite3_bind_int(s, 2, chunk.index % chunks_x);
+		sqlite3_bind_int(s, 3, chunk.index / chunks_x);
+		sqlite3_bind_int64(s, 4, chunk.version);
+		sqlite3_bind_blob(s, 5, chunk.pkt.data(), chunk.pkt.size(), nullptr);
+		good &= ok("chunks_write_s", sqlite3_step(s));
+		ok("chunks_write_r", sqlite3_reset(s));
+		*total_size += chunk.pkt.size();
+	}
+
+	// Now air-only or outside of the world
+	for (const auto &it : stored) {
+		s = m_stmt_chunks_remove;
+		custom_bind_string(s, 1, id);
+		sqlite3_bind_int(s, 2, it.first >> 16);
+		sqlite3_bind_int(s, 3, it.first & 0xFFFF);
+		good &= ok("chunks_remove_s", sqlite3_step(s));
+		ok("chunks_remove_r", sqlite3_reset(s));
+	}
+
+	return good;
+}
+
+bool DatabaseWorld::backfillDataInfo()
+{
+	// Rows written by older versions
+	sqlite3_stmt *s_select = nullptr, *s_update = nullptr;
+	bool good = ok("backfill_select", sqlite3_prepare_v2(m_database,
+		"SELECT `id`, `width`, `height`, `data`, "
+		"(SELECT total(length(`data`)) FROM `world_chunks` WHERE `world_id` = `worlds`.`id`) "
+		"FROM `worlds` WHERE `featured_score` IS NULL",
+		-1, &s_select, nullptr));
+	good &= ok("backfill_update", sqlite3_prepare_v2(m_database,
+		"UPDATE `worlds` SET `data_size` = ?, `format_version` = ?, `featured_score` = ? "
+		"WHERE `id` = ?",
+		-1, &s_update, nullptr));
+
+	size_t count = 0;
+	if (good) {
+		sqlite3_step(m_stmt_begin);
+		sqlite3_reset(m_stmt_begin);
+
+		while (sqlite3_step(s_select) == SQLITE_ROW) {
+			blockpos_t size;
+			size.X = sqlite3_column_int(s_select, 1);
+			size.Y = sqlite3_column_int(s_select, 2);
+			const u8 *data = (const u8 *)sqlite3_column_blob(s_select, 3);
+			const size_t length = sqlite3_column_bytes(s_select, 3);
+			WorldDataInfo info(data, length, sqlite3_column_int64(s_select, 4), size);
+
+			auto s = s_update;
+			sqlite3_bind_int64(s, 1, info.data_size);
+			sqlite3_bind_int(s, 2, info.format_version);
+			sqlite3_bind_double(s, 3, info.featured_score);
+			sqlite3_bind_text(s, 4, (const char *)sqlite3_column_text(s_select, 0), -1, SQLITE_TRANSIENT);
+			good &= ok("backfill_s", sqlite3_step(s));
+			ok("backfill_r", sqlite3_reset(s));
+			count++;
+		}
+		good &= ok("backfill_select", sqlite3_errcode(m_database));
+
+		sqlite3_step(m_stmt_end);
+		sqlite3_reset(m_stmt_end);
+	}
+
+	ok("~backfill_select", sqlite3_finalize(s_select));
+	ok("~backfill_update", sqlite3_finalize(s_update));
+
+	if (count > 0)
+		logger(LL_INFO, "Backfilled the lobby information of %zu world(s)", count);
+	return good;
+}
+
 static void read_world_header(LobbyWorld &meta, sqlite3_stmt *s)
 {
 	meta.id = (const char *)sqlite3_column_text(s, 0);
@@ -248,13 +605,6 @@ std::vector<LobbyWorld> DatabaseWorld::getFeatured() const
 
 	std::vector<LobbyWorld> out;
 	while (sqlite3_step(s) == SQLITE_ROW) {
-		const u8 *data = (u8 *)sqlite3_column_blob(s, 7);
-		const size_t length = sqlite3_column_bytes(s, 7);
-		// Skip non-compressed worlds (version < 5) --> do a fuzzy check.
-		// O E f w METHOD VER CK CK
-		if (length < 8 || data[5] < 5)
-			continue;
-
 		LobbyWorld meta;
 		read_world_header(meta, s);
 
@@ -1,9 +1,32 @@
 #pragma once
 
 #include "database.h"
+#include "core/packet.h"
 #include "core/world.h" // LobbyWorld
+#include <memory>
 #include <vector>
 
+/// World state to write into `DatabaseWorld`
+struct WorldSaveData {
+	/// Copies the metadata and takes a snapshot. Short world lock.
+	/// Call once per instance.
+	void capture(const World *world);
+
+	std::string id, owner, title;
+	u32 plays = 0;
+	bool is_public = false;
+	Packet p_flags;
+	std::shared_ptr<const World> snapshot;
+	/// Blocks restored by /load (nullptr: unchanged)
+	std::shared_ptr<const World> owner_snapshot;
+};
+
+/// `BlockUpdate` records applied after the last full save
+struct WorldJournalData {
+	std::string id;
+	Packet records;
+};
+
 class DatabaseWorld : Database {
 public:
 	DatabaseWorld() : Database() {}
@@ -12,8 +35,14 @@ public:
 	bool tryOpen(const char *filepath) override;
 	void close() override;
 
-	bool load(World *world);
+	/// owner_save: blocks of the last /save instead of the latest
+	/// checkpoint and journal
+	bool load(World *world, bool owner_save = false);
 	bool save(const World *world);
+	/// Serializes and writes all entries within a single transaction.
+	/// Saved worlds start with an empty journal, then `journal` is appended.
+	bool save(const std::vector<WorldSaveData *> &batch,
+		const std::vector<WorldJournalData *> &journal = {});
 
 	std::vector<LobbyWorld> getByPlayer(const std::string &name) const;
 	std::vector<LobbyWorld> getFeatured() const;
@@ -21,6 +50,20 @@ public:
 private:
 	sqlite3_stmt *m_stmt_read = nullptr;
 	sqlite3_stmt *m_stmt_write = nullptr;
+	/// `total_size`: incremented by the size of all stored chunks
+	bool saveChunks(const std::string &id, const World &world, size_t *total_size);
+	/// Migration: computes the lobby information of older rows
+	bool backfillDataInfo();
+
+	sqlite3_stmt *m_stmt_chunks_read = nullptr;
+	sqlite3_stmt *m_stmt_chunks_versions = nullptr;
+	sqlite3_stmt *m_stmt_chunks_write = nullptr;
+	sqlite3_stmt *m_stmt_chunks_remove = nullptr;
+	sqlite3_stmt *m_stmt_journal_read = nullptr;
+	sqlite3_stmt *m_stmt_journal_add = nullptr;
+	sqlite3_stmt *m_stmt_journal_clear = nullptr;
+	sqlite3_stmt *m_stmt_saved_read = nullptr;
+	sqlite3_stmt *m_stmt_saved_write = nullptr;
 
 	sqlite3_stmt *m_stmt_by_player = nullptr;
 	sqlite3_stmt *m_stmt_featured = nullptr;
@@ -4,7 +4,9 @@
 #include "core/player.h"
 #include "core/timer.h"
 #include <unordered_set>
+#include <vector>
 
+class World;
 enum class Packet2Client : uint16_t;
 
 enum class RemotePlayerState {
@@ -32,6 +34,16 @@ public:
 		std::unordered_set<std::string> requested;
 	} media;
 
+	/// Progressive world download after joining, see `Server::stepSendWorldChunks`
+	struct {
+		std::weak_ptr<const World> world; // not reused by other worlds
+		std::vector<size_t> chunks; // nearest to the spawn first
+		size_t next = 0;
+		size_t chunks_per_packet = 8;
+	} world_stream;
+
+	u16 bulk_seq = 0; // last sent, see `Server::sendBulk`
+
 	// Rate limits (incoing requests)
 	RateLimit rl_blocks;
 	RateLimit rl_chat;
@@ -40,5 +52,8 @@ public:
 	void runAnticheat(float dtime);
 	// TODO: Reset when joining a world
 	float time_since_move_pkt = 0;
+	bool move_pending = false; // physics to broadcast in the next step
+	bool move_far_pending = false; // ... to players outside the radius
+	std::unordered_set<peer_t> move_in_range; // players of the previous step, see `Server::stepSendMovement`
 	float cheat_probability = -1;
 };
@@ -4,10 +4,12 @@
 #include "remoteplayer.h"
 #include "servermedia.h"
 #include "serverscript.h"
+#include "worldsaver.h"
 #include "core/blockmanager.h"
 #include "core/logger.h"
 #include "core/network_enums.h"
 #include "core/packet.h"
+#include "core/threadpool.h"
 #include "core/world.h"
 #include "core/worldmeta.h"
 #include "core/script/scriptevent.h"
@@ -24,7 +26,7 @@ static Logger logger("Server", LL_WARN);
 
 static uint16_t PACKET_ACTIONS_MAX; // initialized in ctor
 
-Server::Server(bool *shutdown_requested) :
+Server::Server(bool *shutdown_requested, size_t max_peers) :
 	Environment(new BlockManager()),
 	m_shutdown_requested(shutdown_requested)
 {
@@ -32,7 +34,7 @@ Server::Server(bool *shutdown_requested) :
 	m_stdout_flush_timer.set(1);
 	m_ban_cleanup_timer.set(2);
 
-	m_con = new Connection(Connection::TYPE_SERVER, "Server");
+	m_con = new Connection(Connection::TYPE_SERVER, "Server", max_peers);
 	if (!m_con->listenAsync(*this)) {
 		goto error;
 	}
@@ -46,6 +48,16 @@ Server::Server(bool *shutdown_requested) :
 			m_world_db = nullptr;
 			goto error;
 		}
+
+		// Saving happens on a separate connection
+		m_world_saver = new WorldSaver();
+		if (!m_world_saver->tryOpen("server_worlddata.sqlite")) {
+			logger(LL_ERROR, "Failed to open world database for saving!");
+			delete m_world_saver;
+			m_world_saver = nullptr;
+			goto error;
+		}
+		m_autosave_timer.set(autosave_interval);
 	}
 
 	{
@@ -121,6 +133,7 @@ Server::~Server()
 
 	delete m_con;
 	delete m_auth_db;
+	delete m_world_saver; // finishes pending saves
 	delete m_world_db;
 	delete m_bmgr;
 }
@@ -135,9 +148,14 @@ void Server::step(float dtime)
 		m_is_first_step = false;
 	}
 
+	m_tick_last = std::chrono::steady_clock::now();
+
+	processInbound();
+
 	// always player lock first, world lock after.
 	SimpleLock players_lock(m_players_lock);
 	std::set<RefCnt<World>> worlds;
+	std::map<World *, std::vector<RemotePlayer *>> world_players;
 	for (auto &p : m_players) {
 		RemotePlayer *player = (RemotePlayer *)p.second.get();
 		auto world = player->getWorld();
@@ -148,11 +166,15 @@ void Server::step(float dtime)
 			player->time_since_move_pkt += dtime;
 
 			worlds.emplace(world);
+			world_players[world.get()].push_back(player);
 		}
 
 		stepSendMedia(player);
+		stepSendWorldChunks(player);
 	}
 
+	stepWorldSaveResults();
+
 	// Process script events
 	for (auto &p : m_players) {
 		RemotePlayer *player = (RemotePlayer *)p.second.get();
@@ -166,9 +188,37 @@ void Server::step(float dtime)
 	if (m_script)
 		m_script->onStep((double)getTimeNowDIV() / TIME_RESOLUTION);
 
-	for (auto &world : worlds) {
-		stepSendBlockUpdates(world.get());
-		stepWorldTick(world.get(), dtime);
+	const bool movement_far_update = !m_movement_far_timer.isActive()
+		|| m_movement_far_timer.step(dtime);
+	if (movement_far_update)
+		m_movement_far_timer.set(movement_far_interval);
+
+	/*
+		Worlds are independent: broadcast and tick them in parallel.
+		m_players is not modified meanwhile because packets are handled
+		by this thread (see `processInbound`). Lua is not involved.
+		Packet handling, script callbacks and media remain serial and
+		limit the speedup (see `--benchmark`).
+	*/
+	std::vector<std::pair<World *, const std::vector<RemotePlayer *> *>> jobs;
+	for (auto &world : worlds)
+		jobs.emplace_back(world.get(), &world_players[world.get()]);
+
+	ThreadPool::getShared().run(jobs.size(), [&] (size_t i) {
+		World *world = jobs[i].first;
+		stepSendMovement(*jobs[i].second, movement_far_update);
+		stepSendBlockUpdates(world, *jobs[i].second);
+		stepWorldTick(world, dtime);
+	});
+
+	if (m_world_saver && m_autosave_timer.step(dtime)) {
+		m_autosave_timer.set(autosave_interval);
+
+		// Merge the journals into the world data
+		for (auto &world : worlds) {
+			if (m_world_saver->needsCheckpoint(world->getMeta().id))
+				m_world_saver->enqueue(world.get());
+		}
 	}
 
 	auto respawn_killed = [this] (Player *player) {
@@ -266,6 +316,24 @@ void Server::step(float dtime)
 	}
 
 	m_static_lobby_worlds_timer.step(dtime);
+
+	// Queued sends must not wait for the next `enet_host_service` call
+	flushOutbox();
+	m_con->flush();
+
+	{
+		float used = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_tick_last).count();
+		if (used > tick_interval)
+			m_tick_overruns++;
+
+		m_tick_overrun_timer.step(dtime);
+		if (m_tick_overruns > 0 && !m_tick_overrun_timer.isActive()) {
+			logger(LL_WARN, "%zu tick(s) took longer than %.0f ms (last: %.0f ms)\n",
+				m_tick_overruns, tick_interval * 1000, used * 1000);
+			m_tick_overruns = 0;
+			m_tick_overrun_timer.set(10); // avoid spam
+		}
+	}
 }
 
 // -------------- Utility functions --------------
@@ -320,6 +388,55 @@ void Server::onPeerConnected(peer_t peer_id)
 }
 
 void Server::onPeerDisconnected(peer_t peer_id)
+{
+	// After the remaining packets of this peer
+	m_inbound.push(InboundEvent { peer_id, nullptr });
+}
+
+void Server::processPacket(peer_t peer_id, Packet &pkt)
+{
+	// Handlers take m_players_lock and world locks, which must not
+	// stall the ENet service loop (ACKs, pings).
+	Packet2Server action;
+	{
+		Packet view(&pkt);
+		action = view.read<Packet2Server>();
+	}
+	m_inbound.push(InboundEvent { peer_id, std::make_unique<Packet>(std::move(pkt)) });
+
+	// Movement is batched per tick anyway
+	if (action != Packet2Server::Move) {
+		SimpleLock lock(m_tick_lock);
+		m_tick_wakeup = true;
+		m_tick_cv.notify_one();
+	}
+}
+
+void Server::waitForTick(TimePoint deadline)
+{
+	// Coalesce bursts of packets
+	constexpr auto TICK_MIN = std::chrono::milliseconds(5);
+	std::this_thread::sleep_until(m_tick_last + TICK_MIN);
+
+	SimpleLock lock(m_tick_lock);
+	m_tick_cv.wait_until(lock, deadline, [this] {
+		return m_tick_wakeup || (m_shutdown_requested && *m_shutdown_requested);
+	});
+	m_tick_wakeup = false;
+}
+
+void Server::processInbound()
+{
+	InboundEvent event;
+	while (m_inbound.pop(event)) {
+		if (event.pkt)
+			handlePacket(event.peer_id, *event.pkt);
+		else
+			handlePeerDisconnected(event.peer_id);
+	}
+}
+
+void Server::handlePeerDisconnected(peer_t peer_id)
 {
 	SimpleLock lock(m_players_lock);
 
@@ -332,6 +449,10 @@ void Server::onPeerDisconnected(peer_t peer_id)
 	}
 	assert(player);
 	m_players.erase(peer_id);
+	{
+		SimpleLock lock(m_outbox_lock);
+		m_outbox.erase(peer_id);
+	}
 
 	logger(LL_DEBUG, "Player %s disconnected\n", player->name.c_str());
 	sendPlayerLeave((RemotePlayer *)player.get());
@@ -340,7 +461,7 @@ void Server::onPeerDisconnected(peer_t peer_id)
 		m_script->removePlayer(player.get());
 }
 
-void Server::processPacket(peer_t peer_id, Packet &pkt)
+void Server::handlePacket(peer_t peer_id, Packet &pkt)
 {
 	// one server instance, multiple worlds
 	int action = (int)pkt.read<Packet2Server>();
@@ -392,47 +513,266 @@ void Server::stepSendMedia(RemotePlayer *player)
 
 	if (player->media.requested.empty())
 		return;
-	if (m_con->getPeerBytesInTransit(player->peer_id) > 5 * CONNECTION_MTU)
-		return; // wait a bit
+	if (!canSendBulk(player->peer_id))
+		return;
 
 	Packet out = player->createPacket(Packet2Client::MediaReceive);
 	m_media->writeMediaData(player, out);
-	m_con->send(player->peer_id, 0, out);
+	sendBulk(player, out, false);
+}
+
+void Server::stepSendWorldChunks(RemotePlayer *player)
+{
+	auto &stream = player->world_stream;
+	if (stream.next >= stream.chunks.size())
+		return;
+
+	auto world = player->getWorld();
+	if (!world || world != stream.world.lock()) {
+		// Left or changed the world
+		stream = decltype(player->world_stream)();
+		return;
+	}
+
+	// Encode without blocking block updates of this world
+	std::shared_ptr<const World> snapshot;
+
+	// Limit the data queued per step. `getPeerBytesInTransit` is only
+	// updated once the packets were sent out.
+	size_t sent = 0;
+	while (stream.next < stream.chunks.size() && sent < 5 * CONNECTION_MTU) {
+		if (!canSendBulk(player->peer_id))
+			return;
+
+		const size_t n = std::min(stream.chunks_per_packet, stream.chunks.size() - stream.next);
+		std::vector<size_t> indices(stream.chunks.begin() + stream.next,
+			stream.chunks.begin() + stream.next + n);
+		stream.next += n;
+		const bool is_last = stream.next == stream.chunks.size();
+
+		if (!snapshot) {
+			SimpleLock world_lock(world->mutex);
+			snapshot = world->createSnapshot();
+		}
+
+		Packet out = player->createPacket(Packet2Client::WorldChunks);
+		out.write<u8>(is_last);
+		snapshot->writeChunks(out, indices);
+		// Block updates must not be overwritten by older chunk data
+		sendBulk(player, out, true);
+		sent += out.size();
+
+		// Aim for about one MTU per packet
+		if (out.size() < CONNECTION_MTU / 2 && stream.chunks_per_packet < 64)
+			stream.chunks_per_packet *= 2;
+		else if (out.size() > CONNECTION_MTU * 2 && stream.chunks_per_packet > 1)
+			stream.chunks_per_packet /= 2;
+	}
+
+	if (stream.next >= stream.chunks.size())
+		stream = decltype(player->world_stream)();
+}
+
+/// Appends Move packets (split by MTU) for the given players
+static void write_move_batches(u16 proto_ver, const std::vector<RemotePlayer *> &players,
+	const std::vector<u8> &groups, std::vector<Packet> &out)
+{
+	// Upper size estimate per entry
+	const size_t per_packet = std::max<size_t>(1, (CONNECTION_MTU - 16) / 48);
+
+	for (size_t i = 0; i < players.size(); ++i) {
+		if (i % per_packet == 0) {
+			out.emplace_back();
+			out.back().data_version = proto_ver;
+			out.back().write(Packet2Client::Move);
+		}
+		out.back().write(players[i]->peer_id);
+		players[i]->writePhysics(out.back(), groups[i]);
+	}
+}
+
+// See also: Client::pkt_Move
+void Server::stepSendMovement(const std::vector<RemotePlayer *> &players, bool far_update)
+{
+	/*
+		Spatial grid with the cell size of the radius: nearby moves are
+		sent to the players of the 3x3 surrounding cells, the latest
+		state of all others once per `movement_far_interval`.
+	*/
+	using Cell = std::pair<int, int>;
+	const bool unlimited = movement_radius == 0;
+	auto get_cell = [this, unlimited] (const Player *p) -> Cell {
+		if (unlimited)
+			return { 0, 0 };
+		return { (int)(p->pos.X / movement_radius), (int)(p->pos.Y / movement_radius) };
+	};
+	auto is_near = [] (Cell a, Cell b) {
+		return std::abs(a.first - b.first) <= 1 && std::abs(a.second - b.second) <= 1;
+	};
+
+	std::map<Cell, std::vector<size_t>> grid; // indices of "moved"
+	std::map<Cell, std::vector<peer_t>> grid_all; // for `RemotePlayer::move_in_range`
+	std::vector<RemotePlayer *> moved, far;
+	std::vector<u8> groups;
+	for (RemotePlayer *player : players) {
+		const Cell cell = get_cell(player);
+		grid_all[cell].push_back(player->peer_id);
+		if (player->move_pending) {
+			moved.push_back(player);
+			groups.push_back(player->updatePhysicsBaseline());
+			grid[cell].push_back(moved.size() - 1);
+		}
+		if (far_update && player->move_far_pending)
+			far.push_back(player);
+
+		player->move_pending = false;
+		if (far_update || unlimited)
+			player->move_far_pending = false;
+	}
+
+	struct Batches {
+		std::vector<size_t> near; // indices of "moved"
+		std::vector<Packet> pkt_near, pkt_far;
+	};
+	// Key: (protocol version, cell)
+	std::map<std::pair<u16, Cell>, Batches> cache;
+	for (RemotePlayer *player : players) {
+		if ((int)player->state < (int)RemotePlayerState::WorldPlay)
+			continue;
+
+		const u16 proto_ver = player->protocol_version;
+		const Cell cell = get_cell(player);
+
+		auto it = cache.find({ proto_ver, cell });
+		if (it == cache.end()) {
+			it = cache.emplace(std::make_pair(proto_ver, cell), Batches()).first;
+			Batches &b = it->second;
+
+			std::vector<RemotePlayer *> near_players;
+			std::vector<u8> near_groups;
+			for (int y = cell.second - 1; y <= cell.second + 1; ++y)
+			for (int x = cell.first - 1; x <= cell.first + 1; ++x) {
+				auto it_cell = grid.find({ x, y });
+				if (it_cell == grid.end())
+					continue;
+				for (size_t i : it_cell->second) {
+					b.near.push_back(i);
+					near_players.push_back(moved[i]);
+					near_groups.push_back(groups[i]);
+				}
+			}
+			write_move_batches(proto_ver, near_players, near_groups, b.pkt_near);
+
+			// Nearby players are already covered by the deltas above
+			std::vector<RemotePlayer *> far_players;
+			for (RemotePlayer *p : far) {
+				if (!is_near(get_cell(p), cell))
+					far_players.push_back(p);
+			}
+			// The receivers have missed packets: include all fields
+			const std::vector<u8> far_groups(far_players.size(), Player::PG_ALL);
+			write_move_batches(proto_ver, far_players, far_groups, b.pkt_far);
+		}
+		Batches &b = it->second;
+
+		// Players that come into range have missed the recent deltas
+		std::unordered_set<peer_t> in_range;
+		for (int y = cell.second - 1; y <= cell.second + 1; ++y)
+		for (int x = cell.first - 1; x <= cell.first + 1; ++x) {
+			auto it_cell = grid_all.find({ x, y });
+			if (it_cell != grid_all.end())
+				in_range.insert(it_cell->second.begin(), it_cell->second.end());
+		}
+
+		std::vector<u8> near_groups;
+		bool is_custom = false;
+		for (size_t i : b.near) {
+			const bool is_new = player->move_in_range.count(moved[i]->peer_id) == 0;
+			near_groups.push_back(is_new ? (u8)Player::PG_ALL : groups[i]);
+			is_custom |= is_new;
+		}
+		player->move_in_range.swap(in_range);
+
+		if (is_custom) {
+			// Rare: encode for this receiver only
+			std::vector<RemotePlayer *> near_players;
+			for (size_t i : b.near)
+				near_players.push_back(moved[i]);
+			std::vector<Packet> pkt_near;
+			write_move_batches(proto_ver, near_players, near_groups, pkt_near);
+			for (Packet &pkt : pkt_near)
+				send(player->peer_id, 1 | Connection::FLAG_UNRELIABLE, pkt);
+		} else {
+			for (Packet &pkt : b.pkt_near)
+				send(player->peer_id, 1 | Connection::FLAG_UNRELIABLE, pkt);
+		}
+		for (Packet &pkt : b.pkt_far)
+			send(player->peer_id, 1 | Connection::FLAG_UNRELIABLE, pkt);
+	}
 }
 
 // Similar to Client::pkt_PlaceBlock
-void Server::stepSendBlockUpdates(World *world)
+void Server::stepSendBlockUpdates(World *world, const std::vector<RemotePlayer *> &players)
 {
 	// Process block placement queue of this world for broacast
 	auto &queue = world->proc_queue;
 	if (queue.empty())
 		return;
 
-	Packet out;
-	out.write(Packet2Client::PlaceBlock);
+	// The slowest peer limits how much is sent within this step
+	uint32_t budget = UINT32_MAX;
+	for (RemotePlayer *player : players)
+		budget = std::min(budget, m_con->getPeerSendWindow(player->peer_id));
+
+	std::vector<Packet> packets;
 
 	SimpleLock world_lock(world->mutex);
-	auto it = queue.cbegin();
-	for (; it != queue.cend(); ++it) {
-		// Fit everything into an MTU
-		if (out.size() > CONNECTION_MTU)
-			break;
+	do {
+		Packet &out = packets.emplace_back();
+		out.write(Packet2Client::PlaceBlock);
 
-		// Distribute valid changes to players
+		// Fit everything into an MTU
+		while (!queue.empty() && out.size() <= CONNECTION_MTU) {
+			const BlockUpdate &bu = queue.front();
 
-		// Note: clients <= 1.4.2 (protocol version 9) did 'break' on peer_id == 0 (server).
-		out.write(it->peer_id);
-		// Write BlockUpdate
-		it->write(out);
+			// Note: clients <= 1.4.2 (protocol version 9) did 'break' on peer_id == 0 (server).
+			out.write(bu.peer_id);
+			// Write BlockUpdate
+			bu.write(out);
 
-		DEBUGLOG("Server: sending block x=%d,y=%d,id=%d\n",
-			it->pos.X, it->pos.Y, it->getId());
-	}
+			DEBUGLOG("Server: sending block x=%d,y=%d,id=%d\n",
+				bu.pos.X, bu.pos.Y, bu.getId());
+			queue.pop_front();
+		}
 
-	queue.erase(queue.cbegin(), it); // "it" is not removed.
+		// At least one packet per step to guarantee progress
+		budget -= std::min<uint32_t>(budget, out.size());
+	} while (!queue.empty() && budget > 0);
 	world_lock.unlock();
 
-	broadcastInWorld(world, 0, out);
+	for (Packet &out : packets)
+		broadcastInWorld(world, 0, out);
+}
+
+void Server::stepWorldSaveResults()
+{
+	if (!m_world_saver)
+		return;
+
+	WorldSaver::Result res;
+	while (m_world_saver->popResult(res)) {
+		char buf[255];
+		if (res.ok)
+			snprintf(buf, sizeof(buf), "Saved! (took %.2f ms)", res.seconds * 1000.0f);
+		else
+			snprintf(buf, sizeof(buf), "Failed to save (server error)");
+
+		for (peer_t peer_id : res.peer_ids) {
+			// Might have left in the meantime
+			if (RemotePlayer *player = getPlayerNoLock(peer_id))
+				systemChatSend(player, buf);
+		}
+	}
 }
 
 void Server::stepSendScriptEvents(RemotePlayer *player)
@@ -460,7 +800,7 @@ void Server::stepSendScriptEvents(RemotePlayer *player)
 	count += m_script->getSEMgr()->writeBatchNT(pkt, true, world_se);
 	pkt.write<u16>(UINT16_MAX); // terminate batch
 	if (count > 0)
-		m_con->send(player->peer_id, 1, pkt);
+		send(player->peer_id, 1, pkt);
 }
 
 void Server::stepWorldTick(World *world, float dtime)
@@ -495,9 +835,21 @@ void Server::stepWorldTick(World *world, float dtime)
 	meta.switch_state = sw_new * 0x81;
 }
 
-bool Server::loadWorldNoLock(World *world)
+bool Server::loadWorldNoLock(World *world, bool owner_save)
+{
+	if (!m_world_db || !world)
+		return false;
+
+	if (m_world_saver)
+		m_world_saver->wait(world->getMeta().id); // recent edits
+
+	return m_world_db->load(world, owner_save);
+}
+
+void Server::journalBlockUpdate(const World *world, const BlockUpdate &bu)
 {
-	return m_world_db && world && m_world_db->load(world);
+	if (m_world_saver && world->getMeta().type == WorldMeta::Type::Persistent)
+		m_world_saver->appendJournal(world->getMeta().id, bu);
 }
 
 void Server::writeWorldData(Packet &out, World &world, bool is_clear)
@@ -505,16 +857,92 @@ void Server::writeWorldData(Packet &out, World &world, bool is_clear)
 	out.write(Packet2Client::WorldData);
 	out.write<u8>(1 + is_clear); // 1: new data. 2: clear
 
-	world.getMeta().writeCommon(out);
-	world.getMeta().writeSpecific(out);
+	std::shared_ptr<const World> snapshot;
+	{
+		SimpleLock lock(world.mutex);
+		world.getMeta().writeCommon(out);
+		world.getMeta().writeSpecific(out);
+		if (!is_clear)
+			snapshot = world.createSnapshot();
+	}
+
 	blockpos_t size = world.getSize();
 	out.write(size.X); // dimensions
 	out.write(size.Y);
-	if (!is_clear) {
-		world.write(out, World::Method::Plain);
+	if (snapshot) {
+		// Encode without blocking block updates of this world.
+		// Palette + RLE is much smaller for typical (mostly empty) worlds
+		snapshot->write(out, out.data_version >= 11
+			? World::Method::CompressionV1 : World::Method::Plain);
 	}
 }
 
+bool Server::writeWorldDelta(Packet &out, const World &world, blockpos_t cached_size,
+	const std::vector<u64> &cached_hashes)
+{
+	if (out.data_version < 12 || cached_size != world.getSize())
+		return false;
+
+	const std::vector<u64> hashes = world.getChunkHashes();
+	if (hashes.size() != cached_hashes.size())
+		return false;
+
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < hashes.size(); ++i) {
+		if (hashes[i] != cached_hashes[i])
+			changed.push_back(i);
+	}
+
+	// Mostly modified: the full world data compresses better
+	if (changed.size() * 2 > hashes.size())
+		return false;
+
+	logger(LL_DEBUG, "World delta %s: %zu of %zu chunks",
+		world.getMeta().id.c_str(), changed.size(), hashes.size());
+
+	out.write(Packet2Client::WorldData);
+	out.write<u8>(3); // 3: delta to the cached copy
+
+	world.getMeta().writeCommon(out);
+	world.getMeta().writeSpecific(out);
+	world.writeChunks(out, changed);
+	return true;
+}
+
+// Allocated chunks sent along with the initial `WorldData` packet
+static constexpr size_t WORLD_STREAM_CHUNKS_INITIAL = 25;
+
+bool Server::writeWorldStreamStart(Packet &out, RemotePlayer *player)
+{
+	auto world = player->getWorld();
+	if (out.data_version < 13 || !world)
+		return false;
+
+	const blockpos_t pos(player->pos.X + 0.5f, player->pos.Y + 0.5f);
+	std::vector<size_t> chunks = world->getChunksUsedNear(pos);
+	// Small worlds: a single packet compresses better
+	if (chunks.size() <= WORLD_STREAM_CHUNKS_INITIAL * 2)
+		return false;
+
+	out.write(Packet2Client::WorldData);
+	out.write<u8>(4); // 4: area around the player, remainder follows
+
+	world->getMeta().writeCommon(out);
+	world->getMeta().writeSpecific(out);
+	blockpos_t size = world->getSize();
+	out.write(size.X);
+	out.write(size.Y);
+	world->writeChunks(out, std::vector<size_t>(chunks.begin(),
+		chunks.begin() + WORLD_STREAM_CHUNKS_INITIAL));
+
+	auto &stream = player->world_stream;
+	stream = decltype(player->world_stream)();
+	stream.world = world;
+	stream.chunks = std::move(chunks);
+	stream.next = WORLD_STREAM_CHUNKS_INITIAL;
+	return true;
+}
+
 void Server::setDefaultPlayerFlags(Player *player)
 {
 	auto world = player->getWorld();
@@ -2,9 +2,12 @@
 
 #include "core/chatcommand.h"
 #include "core/environment.h"
+#include "core/mpscqueue.h"
 #include "core/playerflags.h"
 #include "core/timer.h"
 #include "core/types.h" // RefCnt
+#include <chrono>
+#include <condition_variable>
 
 enum class RemotePlayerState;
 
@@ -13,13 +16,16 @@ class DatabaseWorld;
 class RemotePlayer;
 class ServerScript;
 class ServerMedia;
+class WorldSaver;
+struct BlockUpdate;
 struct ServerPacketHandler;
 struct LobbyWorld;
 
 
 class Server : public Environment, public ChatCommandHandler {
 public:
-	Server(bool *shutdown_requested);
+	/// @param max_peers 0: default
+	Server(bool *shutdown_requested, size_t max_peers = 0);
 	~Server();
 
 	void step(float dtime) override;
@@ -27,15 +33,62 @@ public:
 	// ----------- Utility functions -----------
 	RemotePlayer *getPlayerNoLock(peer_t peer_id) const;
 	RefCnt<World> getWorldNoLock(const std::string &id) const;
+	/// Makes an applied edit durable, see `WorldSaver`
+	void journalBlockUpdate(const World *world, const BlockUpdate &bu);
 
 	std::vector<Player *> getPlayersNoLock(const World *world) const override;
 
 	// ----------- Networking -----------
+	// Called by the network thread: only queue for `Server::step`.
 	void onPeerConnected(peer_t peer_id) override;
 	void onPeerDisconnected(peer_t peer_id) override;
 	void processPacket(peer_t peer_id, Packet &pkt) override;
 
+	// ----------- Configuration -----------
+	/// Unreliable movement is sent to players within this distance (blocks,
+	/// at grid cell precision). Farther players receive the latest state
+	/// every `movement_far_interval` seconds. 0 = unlimited.
+	u16 movement_radius = 64;
+	float movement_far_interval = 1.0f;
+	/// Regular interval between two `step` calls (seconds).
+	/// Command line: `--server MAX_PEERS TICK_RATE`
+	float tick_interval = 0.1f;
+	/// Full save of the modified worlds (seconds). Edits in between are
+	/// persisted by the journal.
+	float autosave_interval = 300.0f;
+
+	// ----------- Tick scheduling -----------
+	using TimePoint = std::chrono::steady_clock::time_point;
+	/// Blocks until `deadline` or until latency-sensitive packets arrived.
+	void waitForTick(TimePoint deadline);
+
 private:
+	/// Received from the network thread
+	struct InboundEvent {
+		peer_t peer_id = 0;
+		std::unique_ptr<Packet> pkt; // nullptr: disconnected
+	};
+	MPSCQueue<InboundEvent> m_inbound;
+
+	std::mutex m_tick_lock;
+	std::condition_variable m_tick_cv;
+	bool m_tick_wakeup = false;
+	TimePoint m_tick_last;
+	size_t m_tick_overruns = 0;
+	Timer m_tick_overrun_timer;
+
+	/// Small reliable messages on channel 0, packed into `Packet2Client::Bundle`
+	struct Outbox {
+		std::unique_ptr<Packet> pkt;
+		size_t count = 0;
+	};
+	mutable std::mutex m_outbox_lock;
+	mutable std::unordered_map<peer_t, Outbox> m_outbox;
+
+	void processInbound();
+	void handlePeerDisconnected(peer_t peer_id);
+	void handlePacket(peer_t peer_id, Packet &pkt);
+
 	void pkt_Quack(peer_t peer_id, Packet &pkt);
 	void pkt_Hello(peer_t peer_id, Packet &pkt);
 	void signInPlayer(RemotePlayer *player);
@@ -54,6 +107,20 @@ private:
 	void pkt_FriendAction(peer_t peer_id, Packet &pkt);
 	void pkt_Deprecated(peer_t peer_id, Packet &pkt);
 
+	/// Like `Connection::send` but small messages are aggregated per peer
+	/// until `flushOutbox`. The order on channel 0 is retained.
+	void send(peer_t peer_id, u16 flags, Packet &pkt) const;
+	void flushOutbox();
+	/// Sends the outbox of this peer, then disconnects it
+	void disconnectPeer(peer_t peer_id);
+	void sendOutboxNoLock(peer_t peer_id, Outbox &box) const;
+	/// Large transfers on channel 2 (protocol version >= 16).
+	/// With `barrier`, the client holds back the packets sent afterwards that
+	/// depend on the world data (e.g. block updates) until this one arrived.
+	/// See `Client::needsBulkData`.
+	void sendBulk(RemotePlayer *player, Packet &pkt, bool barrier);
+	/// Pacing of bulk transfers. Leaves room for the other channels.
+	bool canSendBulk(peer_t peer_id) const;
 	void sendMsg(peer_t peer_id, const std::string &text);
 	void sendPlayerLeave(RemotePlayer *player);
 
@@ -67,12 +134,23 @@ private:
 	static const ServerPacketHandler packet_actions[];
 
 	void stepSendMedia(RemotePlayer *player);
-	void stepSendBlockUpdates(World *world);
+	void stepSendWorldChunks(RemotePlayer *player);
+	void stepSendMovement(const std::vector<RemotePlayer *> &players, bool far_update);
+	void stepSendBlockUpdates(World *world, const std::vector<RemotePlayer *> &players);
 	void stepSendScriptEvents(RemotePlayer *player);
 	void stepWorldTick(World *world, float dtime);
+	void stepWorldSaveResults();
 
-	bool loadWorldNoLock(World *world);
+	/// owner_save: revert to the last /save instead of the latest state
+	bool loadWorldNoLock(World *world, bool owner_save = false);
 	void writeWorldData(Packet &out, World &world, bool is_clear);
+	/// Writes the chunks that differ from the client's cached copy.
+	/// Returns false if a full `writeWorldData` is more appropriate.
+	bool writeWorldDelta(Packet &out, const World &world, blockpos_t cached_size,
+		const std::vector<u64> &cached_hashes);
+	/// Writes the area around the player and queues the remaining chunks.
+	/// Returns false if a full `writeWorldData` is more appropriate.
+	bool writeWorldStreamStart(Packet &out, RemotePlayer *player);
 	void setDefaultPlayerFlags(Player *player);
 	void teleportPlayer(Player *player, core::vector2df dst, bool reset_progress = false);
 	void respawnPlayer(Player *player, bool send_packet, bool reset_progress = true);
@@ -87,10 +165,13 @@ private:
 	// ----------- Other members -----------
 	DatabaseAuth *m_auth_db = nullptr;
 	DatabaseWorld *m_world_db = nullptr;
+	WorldSaver *m_world_saver = nullptr; // writes to the same file
 
 	ServerScript *m_script = nullptr;
 	ServerMedia *m_media = nullptr;
 	Timer m_media_unload_timer;
+	Timer m_movement_far_timer;
+	Timer m_autosave_timer;
 
 	bool m_is_first_step = true;
 
@@ -115,6 +196,8 @@ private:
 	/// We might pass "world == nullptr" by accident, thus
 	/// have a separate "any_world" option is safer.
 	Player *findPlayer(const World *world, std::string name, bool any_world = false) const;
+	/// Crash-recovery checkpoint for changes that are not covered by the journal
+	void autosaveWorld(const World *world);
 	void changeWorldOfAllPlayers(const RefCnt<World> before, RefCnt<World> after, bool is_clear);
 
 	CHATCMD_FUNC(chat_Help);
@@ -11,6 +11,7 @@
 #include "server/database_world.h"
 #include "server/remoteplayer.h" // RemotePlayerState
 #include "server/serverscript.h"
+#include "server/worldsaver.h"
 #include "version.h"
 
 #if 0
@@ -95,7 +96,7 @@ void Server::systemChatSend(Player *player, const std::string &msg, bool broadca
 	pkt.write(Packet2Client::Chat);
 	pkt.write<peer_t>(0);
 	pkt.writeStr16(msg);
-	m_con->send(player->peer_id, 0, pkt);
+	send(player->peer_id, 0, pkt);
 }
 
 Player *Server::findPlayer(const World *world, std::string name, bool any_world) const
@@ -113,18 +114,41 @@ Player *Server::findPlayer(const World *world, std::string name, bool any_world)
 	return nullptr;
 }
 
+void Server::autosaveWorld(const World *world)
+{
+	// The journal cannot represent a replaced world: checkpoint instead
+	if (m_world_saver && world->getMeta().type == WorldMeta::Type::Persistent)
+		m_world_saver->enqueue(world);
+}
+
 void Server::changeWorldOfAllPlayers(const RefCnt<World> before, RefCnt<World> after,
 	bool is_clear)
 {
 	FOR_PLAYERS(, player, m_players) {
 		if (player->getWorld() == before) {
 			player->setWorld(after);
+			// Obsoleted by the full world data
+			((RemotePlayer *)player)->world_stream.chunks.clear();
 		}
 	}
 
-	broadcastInWorld(after.get(), RemotePlayerState::WorldJoin, 0, SERVER_PKT_CB {
-		writeWorldData(out, *after.get(), is_clear);
-	});
+	// Similar to `broadcastInWorld` but on the bulk channel
+	std::map<u16, Packet> compat;
+	FOR_PLAYERS(, p, m_players) {
+		auto player = (RemotePlayer *)p;
+		if (player->getWorld() != after)
+			continue;
+		if ((int)player->state < (int)RemotePlayerState::WorldJoin)
+			continue;
+
+		auto it = compat.find(player->protocol_version);
+		if (it == compat.end()) {
+			it = compat.emplace(player->protocol_version, Packet()).first;
+			it->second.data_version = player->protocol_version;
+			writeWorldData(it->second, *after.get(), is_clear);
+		}
+		sendBulk(player, it->second, true);
+	}
 }
 
 
@@ -157,6 +181,7 @@ CHATCMD_FUNC(Server::chat_Help)
 		// World control
 		{ "clear", "Syntax: /clear [W] [H]\nW,H: integer (optional) to specify the new world dimensions." },
 		{ "import", "Syntax: /import FILENAME\nFILENAME: .eelvl format without the file extension" },
+		{ "load", "Reverts the world to the last /save." },
 		{ "save", "Saves the world blocks, meta and player flags." },
 		{ "title", "Syntax: /title TITLE\nChanges the world's title (use /save to persist)" },
 		// Other
@@ -341,7 +366,7 @@ CHATCMD_FUNC(Server::chat_Ban)
 	if (m_auth_db->getBanRecord(entry.affected, entry.context, &entry)) {
 		// Why are they still here?
 		systemChatSend(target, "Ban circumvention??");
-		m_con->disconnect(target->peer_id);
+		disconnectPeer(target->peer_id);
 		systemChatSend(player, "Oops. They're gone now.");
 		return;
 	}
@@ -412,7 +437,7 @@ CHATCMD_FUNC(Server::chat_Code)
 		Packet out;
 		out.write(Packet2Client::PlayerFlags);
 		player->writeFlags(out, flags);
-		m_con->send(player->peer_id, 1, out);
+		send(player->peer_id, 1, out);
 	}
 }
 
@@ -579,7 +604,7 @@ void Server::handlePlayerFlagsChange(Player *player, playerflags_t flags_mask)
 		Packet out;
 		out.write(Packet2Client::PlayerFlags);
 		player->writeFlags(out, flags_mask);
-		m_con->send(player->peer_id, 1, out);
+		send(player->peer_id, 1, out);
 	}
 
 	// Notify the other players
@@ -755,6 +780,7 @@ CHATCMD_FUNC(Server::chat_Clear)
 
 	changeWorldOfAllPlayers(old_world, world, true);
 	old_world.reset();
+	autosaveWorld(world.get());
 
 	if (m_script)
 		m_script->onWorldData(world.get());
@@ -796,6 +822,7 @@ CHATCMD_FUNC(Server::chat_Import)
 
 	changeWorldOfAllPlayers(old_world, world, false);
 	old_world.reset();
+	autosaveWorld(world.get());
 
 	if (m_script)
 		m_script->onWorldData(world.get());
@@ -830,7 +857,7 @@ void Server::sendPlayerFlags(const World *world)
 			pkt_prv.write(Packet2Client::PlayerFlags);
 			player->writeFlags(pkt_prv, PlayerFlags::PF_MASK_SEND_PLAYER);
 			// Channel 0 like the block data
-			m_con->send(player->peer_id, 0, pkt_prv);
+			send(player->peer_id, 0, pkt_prv);
 		}
 
 		if (player->godmode && !pf.check(PlayerFlags::PF_GODMODE)) {
@@ -857,13 +884,14 @@ CHATCMD_FUNC(Server::chat_Load)
 
 	auto old_world = player->getWorld();
 	auto world = old_world->copyNewSkeleton();
-	if (!loadWorldNoLock(world.get())) {
+	if (!loadWorldNoLock(world.get(), true)) {
 		systemChatSend(player, "Failed to load world from database");
 		return;
 	}
 
 	changeWorldOfAllPlayers(old_world, world, false);
 	old_world.reset();
+	autosaveWorld(world.get());
 
 	FOR_PLAYERS(, player, m_players) {
 		if (player->getWorld() == world)
@@ -892,7 +920,7 @@ CHATCMD_FUNC(Server::chat_Load)
 
 CHATCMD_FUNC(Server::chat_Save)
 {
-	if (!m_world_db)
+	if (!m_world_saver)
 		return;
 
 	auto world = player->getWorld();
@@ -921,16 +949,8 @@ CHATCMD_FUNC(Server::chat_Save)
 		m_auth_db->ban(entry);
 	}
 
-	TimeTaker tt(true);
-	bool ok = m_world_db->save(world.get());
-	double elapsed = tt.stop();
-
-	if (ok) {
-		char buf[255];
-		snprintf(buf, sizeof(buf), "Saved! (took %.2f ms)", elapsed * 1000.0f);
-		systemChatSend(player, buf);
-	} else
-		systemChatSend(player, "Failed to save (server error)");
+	// Result is reported by `stepWorldSaveResults`
+	m_world_saver->enqueue(world.get(), player->peer_id, true);
 }
 
 CHATCMD_FUNC(Server::chat_Title)
@@ -61,7 +61,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 
 		logger(LL_PRINT, "Protocol mismatch. peer_id=%u tried to connect: %s\n", peer_id, buf);
 		sendMsg(peer_id, std::string("Incompatible protocol versions. ") + buf);
-		m_con->disconnect(peer_id);
+		disconnectPeer(peer_id);
 		return;
 	}
 
@@ -72,7 +72,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 
 	if (!ok) {
 		sendMsg(peer_id, "Invalid nickname (must be [A-z0-9]{3,16})");
-		m_con->disconnect(peer_id);
+		disconnectPeer(peer_id);
 		return;
 	}
 
@@ -96,7 +96,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 		reply.write(player->peer_id);
 		reply.writeStr16(player->name);
 
-		m_con->send(peer_id, 0, reply);
+		send(peer_id, 0, reply);
 	}
 
 	logger(LL_PRINT, "Hello from %s, proto_ver=%d\n", player->name.c_str(), player->protocol_version);
@@ -114,7 +114,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 
 		if (!is_guest) {
 			sendMsg(peer_id, "Temporary accounts (guest) must follow the naming scheme GUEST[0-9]*");
-			m_con->disconnect(peer_id);
+			disconnectPeer(peer_id);
 			return;
 		}
 	}
@@ -129,7 +129,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 
 	if (!m_auth_db) {
 		sendMsg(peer_id, "Server error: Auth database error. Please use GuestXXXX accounts.");
-		m_con->disconnect(peer_id);
+		disconnectPeer(peer_id);
 		return;
 	}
 
@@ -145,7 +145,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 		out.writeStr16("login1");
 		out.writeStr16(m_auth_db->getUniqueSalt());
 		out.writeStr16(player->auth.salt_challenge); // challenge
-		m_con->send(peer_id, 0, out);
+		send(peer_id, 0, out);
 	} else {
 		player->auth.status = Auth::Status::Unregistered;
 
@@ -153,7 +153,7 @@ void Server::pkt_Hello(peer_t peer_id, Packet &pkt)
 		out.write(Packet2Client::Auth);
 		out.writeStr16("register");
 		out.writeStr16(m_auth_db->getUniqueSalt());
-		m_con->send(peer_id, 0, out);
+		send(peer_id, 0, out);
 	}
 }
 
@@ -167,7 +167,7 @@ void Server::signInPlayer(RemotePlayer *player)
 		Packet out;
 		out.write(Packet2Client::Auth);
 		out.writeStr16("signed_in");
-		m_con->send(player->peer_id, 0, out);
+		send(player->peer_id, 0, out);
 	}
 
 	ASSERT_FORCED(m_media, "Missing ServerMedia");
@@ -175,7 +175,7 @@ void Server::signInPlayer(RemotePlayer *player)
 	{
 		Packet out = player->createPacket(Packet2Client::MediaList);
 		m_media->writeMediaList(player, out);
-		m_con->send(player->peer_id, 0, out);
+		send(player->peer_id, 0, out);
 	}
 }
 
@@ -237,7 +237,7 @@ void Server::pkt_Auth(peer_t peer_id, Packet &pkt)
 				m_auth_db->ban(entry);
 			}
 			sendMsg(peer_id, "Incorrect password");
-			m_con->disconnect(peer_id);
+			disconnectPeer(peer_id);
 			return;
 		}
 
@@ -334,7 +334,7 @@ void Server::pkt_Auth(peer_t peer_id, Packet &pkt)
 		Packet out;
 		out.write(Packet2Client::Auth);
 		out.writeStr16("pass_set");
-		m_con->send(peer_id, 0, out);
+		send(peer_id, 0, out);
 		return;
 	}
 
@@ -470,7 +470,7 @@ void Server::pkt_GetLobby(peer_t peer_id, Packet &)
 		out.write<u8>(false); // done with friends
 	}
 
-	m_con->send(peer_id, 0, out);
+	send(peer_id, 0, out);
 }
 
 void Server::pkt_Join(peer_t peer_id, Packet &pkt)
@@ -484,12 +484,25 @@ void Server::pkt_Join(peer_t peer_id, Packet &pkt)
 	blockpos_t size { 100, 75 };
 	std::string title, code;
 
-	if (pkt.getRemainingBytes() > 0) {
+	// Chunk hashes of the client's cached copy (proto >= 12)
+	std::vector<u64> cached_hashes;
+
+	if (create_world && pkt.getRemainingBytes() > 0) {
 		world_type = (WorldMeta::Type)pkt.read<u8>();
 		pkt.read(size.X);
 		pkt.read(size.Y);
 		title = pkt.readStr16();
 		code  = strtrim(pkt.readStr16());
+	} else if (pkt.getRemainingBytes() > 0) {
+		pkt.read(size.X);
+		pkt.read(size.Y);
+		u32 count = pkt.read<u32>();
+		if (count > pkt.getRemainingBytes() / sizeof(u64))
+			throw std::runtime_error("Invalid chunk hash count");
+
+		cached_hashes.resize(count);
+		for (u64 &hash : cached_hashes)
+			hash = pkt.read<u64>();
 	}
 
 	if (create_world) {
@@ -597,20 +610,22 @@ void Server::pkt_Join(peer_t peer_id, Packet &pkt)
 			if (p.second->name != player->name)
 				continue;
 
-			if (p.second->getWorld() == world) {
-				sendMsg(peer_id, "You already joined this world.");
+			if (p.second->getWorld() != world)
+				continue;
+
+			if (p.second.get() == player && cached_hashes.empty()) {
+				// The client could not apply the delta (mode 3)
+				Packet out;
+				out.data_version = player->protocol_version;
+				writeWorldData(out, *world.get(), false);
+				sendBulk(player, out, true);
 				return;
 			}
+			sendMsg(peer_id, "You already joined this world.");
+			return;
 		}
 	}
 
-	{
-		Packet out;
-		out.data_version = player->protocol_version;
-		writeWorldData(out, *world.get(), false);
-		m_con->send(peer_id, 0, out);
-	}
-
 	{
 		// Update player information
 		player->setWorld(world);
@@ -618,6 +633,18 @@ void Server::pkt_Join(peer_t peer_id, Packet &pkt)
 		player->state = RemotePlayerState::WorldPlay;
 	}
 
+	{
+		// The spawn position is known: stream outwards from there
+		Packet out;
+		out.data_version = player->protocol_version;
+		bool done = !cached_hashes.empty() && writeWorldDelta(out, *world.get(), size, cached_hashes);
+		if (!done)
+			done = writeWorldStreamStart(out, player);
+		if (!done)
+			writeWorldData(out, *world.get(), false);
+		sendBulk(player, out, true);
+	}
+
 	if (m_script)
 		m_script->onPlayerEvent("join", player);
 
@@ -649,7 +676,7 @@ void Server::pkt_Join(peer_t peer_id, Packet &pkt)
 		Packet out;
 		out.data_version = p2->protocol_version;
 		make_join_packet(p2, out);
-		m_con->send(peer_id, 0, out);
+		send(peer_id, 0, out);
 	}
 
 	// Chat history replay
@@ -663,7 +690,7 @@ void Server::pkt_Join(peer_t peer_id, Packet &pkt)
 			out.writeStr16(entry.message);
 		}
 		if (out.size() > 2)
-			m_con->send(peer_id, 0, out);
+			send(peer_id, 0, out);
 	}
 
 	// Player flags
@@ -683,14 +710,14 @@ void Server::pkt_Join(peer_t peer_id, Packet &pkt)
 				continue;
 
 			// Notify existing players
-			m_con->send(p.first, 0, pkt_new);
+			send(p.first, 0, pkt_new);
 
 			// Append for new player
 			p.second->writeFlags(out, PlayerFlags::PF_MASK_SEND_PLAYER);
 		}
 
 		if (out.size() > 2)
-			m_con->send(player->peer_id, 0, out);
+			send(player->peer_id, 0, out);
 	}
 
 	logger(LL_INFO, "Player %s joined world id=%s",
@@ -726,16 +753,9 @@ void Server::pkt_Move(peer_t peer_id, Packet &pkt)
 	player->runAnticheat(player->time_since_move_pkt);
 	player->time_since_move_pkt = 0;
 
-	// broadcast to connected players
-	broadcastInWorld(player->getWorld().get(),
-			RemotePlayerState::WorldPlay, 1 | Connection::FLAG_UNRELIABLE,
-			SERVER_PKT_CB {
-		out.write(Packet2Client::Move);
-
-		// Bulk sending (future)
-		out.write(peer_id);
-		player->writePhysics(out);
-	});
+	// Broadcast in bulk, see `Server::stepSendMovement`
+	player->move_pending = true;
+	player->move_far_pending = true;
 }
 
 void Server::pkt_Chat(peer_t peer_id, Packet &pkt)
@@ -841,6 +861,7 @@ void Server::pkt_PlaceBlock(peer_t peer_id, Packet &pkt)
 		}
 
 		(void)world->updateBlockNoCheck(bu);
+		journalBlockUpdate(world.get(), bu);
 		// Put into queue to keep the world lock as short as possible
 		world->proc_queue.insert(bu);
 	}
@@ -1071,12 +1092,120 @@ void Server::pkt_Deprecated(peer_t peer_id, Packet &pkt)
 		name.c_str(), peer_id);
 }
 
+void Server::send(peer_t peer_id, u16 flags, Packet &pkt) const
+{
+	// Large packets are not worth the copy
+	bool bundle = flags == 0 && pkt.size() <= CONNECTION_MTU / 2;
+	if (bundle) {
+		RemotePlayer *player = getPlayerNoLock(peer_id);
+		bundle = player && player->protocol_version >= 15;
+	}
+
+	SimpleLock lock(m_outbox_lock);
+	auto it = m_outbox.find(peer_id);
+
+	if (!bundle) {
+		// Must not overtake the queued messages (reliable, channel 0)
+		if (it != m_outbox.end() && flags == 0)
+			sendOutboxNoLock(peer_id, it->second);
+
+		m_con->send(peer_id, flags, pkt);
+		return;
+	}
+
+	if (it == m_outbox.end())
+		it = m_outbox.emplace(peer_id, Outbox()).first;
+
+	Outbox &box = it->second;
+	if (box.pkt && box.pkt->size() + sizeof(u16) + pkt.size() > CONNECTION_MTU)
+		sendOutboxNoLock(peer_id, box);
+
+	if (!box.pkt) {
+		box.pkt = std::make_unique<Packet>();
+		box.pkt->write(Packet2Client::Bundle);
+	}
+
+	// Length-prefixed sub-message, including its Packet2Client
+	box.pkt->write<u16>(pkt.size());
+	box.pkt->writeRaw(pkt.data(), pkt.size());
+	box.count++;
+}
+
+void Server::disconnectPeer(peer_t peer_id)
+{
+	{
+		// The queued messages (e.g. the reason) must arrive first
+		SimpleLock lock(m_outbox_lock);
+		auto it = m_outbox.find(peer_id);
+		if (it != m_outbox.end())
+			sendOutboxNoLock(peer_id, it->second);
+	}
+	m_con->disconnect(peer_id);
+}
+
+void Server::flushOutbox()
+{
+	SimpleLock lock(m_outbox_lock);
+	for (auto &it : m_outbox)
+		sendOutboxNoLock(it.first, it.second);
+}
+
+void Server::sendOutboxNoLock(peer_t peer_id, Outbox &box) const
+{
+	if (!box.pkt)
+		return;
+
+	if (box.count == 1) {
+		// No need for a container
+		const size_t offset = sizeof(Packet2Client) + sizeof(u16);
+		Packet single(box.pkt->data() + offset, box.pkt->size() - offset);
+		m_con->send(peer_id, 0, single);
+	} else {
+		m_con->send(peer_id, 0, *box.pkt);
+	}
+
+	box.pkt.reset();
+	box.count = 0;
+}
+
+void Server::sendBulk(RemotePlayer *player, Packet &pkt, bool barrier)
+{
+	if (player->protocol_version < 16) {
+		send(player->peer_id, 0, pkt);
+		return;
+	}
+
+	const u16 seq = ++player->bulk_seq;
+
+	Packet out(pkt.size() + 8);
+	out.write(Packet2Client::Bulk);
+	out.write(seq);
+	out.writeRaw(pkt.data(), pkt.size());
+	m_con->send(player->peer_id, 2, out);
+
+	if (barrier) {
+		// Channel 0 packets might depend on this data (e.g. block updates)
+		Packet wait;
+		wait.write(Packet2Client::BulkBarrier);
+		wait.write(seq);
+		send(player->peer_id, 0, wait);
+	}
+}
+
+bool Server::canSendBulk(peer_t peer_id) const
+{
+	if (m_con->getPeerBytesInTransit(peer_id) > 5 * CONNECTION_MTU)
+		return false; // wait a bit
+
+	return m_con->getPeerSendWindow(peer_id) >= 2 * CONNECTION_MTU;
+}
+
 void Server::sendMsg(peer_t peer_id, const std::string &text)
 {
 	Packet pkt;
 	pkt.write<Packet2Client>(Packet2Client::Message);
 	pkt.writeStr16(text);
-	m_con->send(peer_id, 0, pkt);
+	send(peer_id, 0, pkt);
 }
 
 void Server::sendPlayerLeave(RemotePlayer *player)
@@ -1112,7 +1241,7 @@ void Server::broadcastInWorld(const World *world, int flags, Packet &pkt)
 		if (p.second->getWorld().get() != world)
 			continue;
 
-		m_con->send(p.first, flags, pkt);
+		send(p.first, flags, pkt);
 	}
 }
 
@@ -1151,7 +1280,7 @@ void Server::broadcastInWorld(const World *world, RemotePlayerState min_state,
 		if (pkt->size() <= sizeof(Packet2Client))
 			continue;
 
-		m_con->send(it.first, flags, *pkt);
+		send(it.first, flags, *pkt);
 		DEBUGLOG("broadcastInWorld: send after cb. name=%s, ver=%d\n",
 			it.second->name.c_str(), p->protocol_version);
 	}
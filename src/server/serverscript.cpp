@@ -97,9 +97,10 @@ int ServerScript::l_world_set_block(lua_State *L)
 	}
 
 	// See also: `Server::pkt_PlaceBlock`
-	const Block *block = world->updateBlock(bu);
-	if (block)
+	if (world->updateBlock(bu)) {
+		script->m_server->journalBlockUpdate(world, bu);
 		world->proc_queue.insert(bu);
+	}
 
 	return 0;
 }
@@ -0,0 +1,175 @@
+#include "worldsaver.h"
+#include "database_world.h"
+#include "core/logger.h"
+#include "core/packet.h"
+#include "core/world.h" // BlockUpdate
+#include "core/utils.h" // TimeTaker
+
+static Logger logger("WorldSaver", LL_INFO);
+
+using seconds_f = std::chrono::duration<float>;
+
+WorldSaver::~WorldSaver()
+{
+	{
+		SimpleLock lock(m_lock);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool WorldSaver::tryOpen(const char *filepath)
+{
+	m_db = std::make_unique<DatabaseWorld>();
+	if (!m_db->tryOpen(filepath)) {
+		m_db.reset();
+		return false;
+	}
+
+	m_thread = std::thread(&WorldSaver::threadMain, this);
+	return true;
+}
+
+void WorldSaver::enqueue(const World *world, peer_t peer_id, bool owner_save)
+{
+	auto data = std::make_unique<WorldSaveData>();
+	data->capture(world);
+	if (owner_save)
+		data->owner_snapshot = data->snapshot;
+
+	{
+		SimpleLock lock(m_lock);
+		// Contained in the snapshot
+		m_journal.erase(data->id);
+		m_unsaved.erase(data->id);
+
+		Job &job = m_pending[data->id];
+		// The newer snapshot replaces the pending one
+		if (job.data && !data->owner_snapshot)
+			data->owner_snapshot = std::move(job.data->owner_snapshot);
+		job.data = std::move(data);
+		if (peer_id)
+			job.peer_ids.push_back(peer_id);
+	}
+	m_cv.notify_one();
+}
+
+void WorldSaver::appendJournal(const std::string &world_id, const BlockUpdate &bu)
+{
+	SimpleLock lock(m_lock);
+	auto &journal = m_journal[world_id];
+	if (!journal) {
+		journal = std::make_unique<WorldJournalData>();
+		journal->id = world_id;
+		journal->records.data_version = PROTOCOL_VERSION_FAKE_DISK;
+	}
+	bu.write(journal->records);
+	m_unsaved.insert(world_id);
+}
+
+bool WorldSaver::needsCheckpoint(const std::string &world_id)
+{
+	SimpleLock lock(m_lock);
+	return m_unsaved.count(world_id) > 0;
+}
+
+void WorldSaver::wait()
+{
+	SimpleLock lock(m_lock);
+	if (!m_thread.joinable())
+		return;
+
+	m_flush = true;
+	m_cv.notify_one();
+	m_cv_done.wait(lock, [this] {
+		return m_writing.empty() && m_pending.empty() && m_journal.empty();
+	});
+}
+
+void WorldSaver::wait(const std::string &world_id)
+{
+	SimpleLock lock(m_lock);
+	if (!m_thread.joinable())
+		return;
+
+	auto is_written = [this, &world_id] {
+		return !m_writing.count(world_id) && !m_pending.count(world_id)
+			&& !m_journal.count(world_id);
+	};
+	if (is_written())
+		return;
+
+	m_flush = true;
+	m_cv.notify_one();
+	m_cv_done.wait(lock, is_written);
+}
+
+bool WorldSaver::popResult(Result &out)
+{
+	return m_results.pop(out);
+}
+
+void WorldSaver::threadMain()
+{
+	SimpleLock lock(m_lock);
+	while (true) {
+		m_cv.wait_for(lock, seconds_f(journal_interval), [this] {
+			return m_stop || m_flush || !m_pending.empty();
+		});
+		if (m_pending.empty() && m_journal.empty()) {
+			m_flush = false;
+			m_cv_done.notify_all();
+			if (m_stop)
+				break;
+			continue;
+		}
+
+		if (!m_stop && !m_flush && !m_pending.empty()) {
+			// Collect more worlds for this transaction
+			m_cv.wait_for(lock, seconds_f(batch_delay),
+				[this] { return m_stop || m_flush; });
+		}
+
+		std::map<std::string, Job> jobs;
+		jobs.swap(m_pending);
+		std::map<std::string, std::unique_ptr<WorldJournalData>> journal;
+		journal.swap(m_journal);
+		for (auto &it : jobs)
+			m_writing.insert(it.first);
+		for (auto &it : journal)
+			m_writing.insert(it.first);
+		lock.unlock();
+
+		std::vector<WorldSaveData *> batch;
+		for (auto &it : jobs)
+			batch.push_back(it.second.data.get());
+		std::vector<WorldJournalData *> records;
+		for (auto &it : journal)
+			records.push_back(it.second.get());
+
+		TimeTaker tt(true);
+		bool ok = m_db->save(batch, records);
+		float elapsed = tt.stop();
+
+		if (!batch.empty()) {
+			logger(LL_INFO, "Saved %zu world(s) in %.2f ms, ok=%d",
+				batch.size(), elapsed * 1000.0f, (int)ok);
+		}
+
+		for (auto &it : jobs) {
+			Result res;
+			res.world_id = it.first;
+			res.peer_ids = std::move(it.second.peer_ids);
+			res.ok = ok;
+			res.seconds = elapsed;
+			m_results.push(std::move(res));
+		}
+
+		lock.lock();
+		m_writing.clear();
+		m_cv_done.notify_all();
+	}
+}
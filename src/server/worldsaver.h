@@ -0,0 +1,85 @@
+#pragma once
+
+#include "core/macros.h"
+#include "core/mpscqueue.h"
+#include "core/types.h"
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BlockUpdate;
+class DatabaseWorld;
+class World;
+struct WorldJournalData;
+struct WorldSaveData;
+
+/// Writes worlds to the database on a separate thread and connection.
+/// Saves of the same world are merged while pending. All pending worlds
+/// and journals are written within a single transaction.
+/// The world data is the crash-recovery checkpoint, the journal holds the
+/// edits since then. The owner's /save is stored separately.
+class WorldSaver {
+public:
+	WorldSaver() = default;
+	/// Finishes the pending saves
+	~WorldSaver();
+	DISABLE_COPY(WorldSaver)
+
+	bool tryOpen(const char *filepath);
+
+	/// Takes a snapshot of the world. `peer_id` receives the result (0: none).
+	/// Replaces the journal of this world.
+	/// owner_save: also the state restored by /load
+	void enqueue(const World *world, peer_t peer_id = 0, bool owner_save = false);
+
+	/// Appends an edit that was already applied to the world
+	void appendJournal(const std::string &world_id, const BlockUpdate &bu);
+	/// Whether journal records were added since the last `enqueue`
+	bool needsCheckpoint(const std::string &world_id);
+
+	/// Blocks until everything queued so far is written
+	void wait();
+	/// Blocks until the queued saves and journal of this world are written
+	void wait(const std::string &world_id);
+
+	struct Result {
+		std::string world_id;
+		std::vector<peer_t> peer_ids;
+		bool ok = false;
+		float seconds = 0; // duration of the batch
+	};
+	/// Completed saves. Returns false if none are available.
+	bool popResult(Result &out);
+
+	/// Time to wait for more saves before starting a transaction
+	float batch_delay = 0.1f;
+	/// Maximal time until journal records are written
+	float journal_interval = 3.0f;
+
+private:
+	struct Job {
+		std::unique_ptr<WorldSaveData> data;
+		std::vector<peer_t> peer_ids;
+	};
+
+	void threadMain();
+
+	std::unique_ptr<DatabaseWorld> m_db;
+	std::thread m_thread;
+
+	std::mutex m_lock;
+	std::condition_variable m_cv;
+	std::condition_variable m_cv_done;
+	std::map<std::string, Job> m_pending; // key: world ID
+	std::map<std::string, std::unique_ptr<WorldJournalData>> m_journal;
+	std::set<std::string> m_unsaved; // journal since the last snapshot
+	std::set<std::string> m_writing; // world IDs of the current transaction
+	bool m_flush = false; // skip the delays
+	bool m_stop = false;
+
+	MPSCQueue<Result> m_results;
+};
@@ -0,0 +1,146 @@
+#include "unittest_internal.h"
+#include "core/connection.h"
+#include "core/network_enums.h"
+#include "core/packet.h"
+#include "core/world.h"
+#include "core/worldmeta.h"
+#include "server/remoteplayer.h"
+#include "server/server.h"
+#include <enet/enet.h>
+#include <chrono>
+#include <ctime> // std::clock
+
+void sleep_ms(long delay);
+
+/*
+	Measures `Server::step` with many connected peers. Every active peer
+	creates a temporary world, then moves and places a block per tick.
+	Requires the game assets and uses the server databases of the working
+	directory. Not part of the unittests, see `--benchmark`.
+*/
+void benchmark_server(size_t peers_idle, size_t peers_active)
+{
+	const size_t peers_total = peers_idle + peers_active;
+	constexpr int TICKS = 100;
+
+	bool shutdown_requested = false;
+	Server server(&shutdown_requested, peers_total);
+	CHECK(!shutdown_requested);
+
+	ENetHost *clients = enet_host_create(nullptr, peers_total, 3, 0, 0);
+	CHECK(clients);
+
+	ENetAddress address;
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = Connection::PORT_DEFAULT;
+
+	std::vector<ENetPeer *> peers;
+	for (size_t i = 0; i < peers_total; ++i)
+		peers.push_back(enet_host_connect(clients, &address, 3, 0));
+
+	auto service = [clients] (int timeout_ms) {
+		ENetEvent event;
+		while (enet_host_service(clients, &event, timeout_ms) > 0) {
+			if (event.type == ENET_EVENT_TYPE_RECEIVE)
+				enet_packet_destroy(event.packet);
+			timeout_ms = 0;
+		}
+	};
+	auto send = [] (ENetPeer *peer, u8 channel, const Packet &pkt, bool reliable) {
+		enet_peer_send(peer, channel, enet_packet_create(pkt.data(), pkt.size(),
+			reliable ? ENET_PACKET_FLAG_RELIABLE : 0));
+	};
+	auto run_server = [&] (int steps) {
+		for (int i = 0; i < steps; ++i) {
+			service(10);
+			server.step(server.tick_interval);
+		}
+	};
+
+	auto count_connected = [&peers] () {
+		size_t count = 0;
+		for (ENetPeer *peer : peers)
+			count += peer->state == ENET_PEER_STATE_CONNECTED;
+		return count;
+	};
+	for (int i = 0; i < 600 && count_connected() < peers_total; ++i)
+		run_server(1);
+	CHECK(count_connected() == peers_total);
+
+	// Guests log in instantly
+	for (size_t i = 0; i < peers_total; ++i) {
+		Packet pkt;
+		pkt.write(Packet2Server::Hello);
+		pkt.write(PROTOCOL_VERSION_MAX);
+		pkt.write(PROTOCOL_VERSION_MIN);
+		pkt.writeStr16("GUEST" + std::to_string(i));
+		pkt.write<u8>(0); // no audiovisuals
+		send(peers[i], 0, pkt, true);
+	}
+	run_server(20);
+
+	for (size_t i = 0; i < peers_active; ++i) {
+		Packet pkt;
+		pkt.write(Packet2Server::Join);
+		pkt.writeStr16(""); // create
+		pkt.write<u8>((u8)WorldMeta::Type::TmpSimple);
+		pkt.write<u16>(200);
+		pkt.write<u16>(150);
+		pkt.writeStr16("Benchmark");
+		pkt.writeStr16(""); // code
+		send(peers[i], 0, pkt, true);
+	}
+	run_server(50);
+
+	RemotePlayer dummy(0, PROTOCOL_VERSION_MAX);
+	BlockUpdate bu(g_blockmanager);
+
+	float step_max = 0,
+		step_sum = 0,
+		cpu_sum = 0;
+	for (int tick = 0; tick < TICKS; ++tick) {
+		for (size_t i = 0; i < peers_active; ++i) {
+			Packet pkt_move;
+			pkt_move.data_version = PROTOCOL_VERSION_MAX;
+			pkt_move.write(Packet2Server::Move);
+			dummy.pos = core::vector2df(10 + (tick % 20) * 0.2f, 20);
+			dummy.vel.X = (tick % 20 < 10) ? 2 : -2;
+			dummy.writePhysics(pkt_move, dummy.updatePhysicsBaseline());
+			send(peers[i], 1, pkt_move, false);
+
+			Packet pkt_place;
+			pkt_place.data_version = PROTOCOL_VERSION_MAX;
+			pkt_place.write(Packet2Server::PlaceBlock);
+			pkt_place.write<u8>(true);
+			bu.pos = blockpos_t(tick % 200, 10 + i % 100);
+			CHECK(bu.set(tick % 2 ? Block::ID_COIN : 0));
+			bu.write(pkt_place);
+			pkt_place.write<u8>(false);
+			send(peers[i], 0, pkt_place, true);
+		}
+		service(0);
+		sleep_ms(20); // received by the network thread
+
+		auto t_start = std::chrono::steady_clock::now();
+		std::clock_t cpu_start = std::clock();
+		server.step(server.tick_interval);
+		float dtime = std::chrono::duration<float>(std::chrono::steady_clock::now() - t_start).count();
+		float cputime = (std::clock() - cpu_start) / (float)CLOCKS_PER_SEC;
+
+		step_max = std::max(step_max, dtime);
+		step_sum += dtime;
+		cpu_sum += cputime;
+	}
+
+	// CPU/wall > 1: the worlds (one per active peer) were stepped on multiple
+	// cores. The network thread is included in the CPU time.
+	printf("benchmark_server: %zu idle + %zu active peers, step avg=%.3f ms, max=%.3f ms, "
+		"CPU/wall=%.2f\n",
+		peers_idle, peers_active, 1000 * step_sum / TICKS, 1000 * step_max,
+		cpu_sum / step_sum);
+
+	for (ENetPeer *peer : peers)
+		enet_peer_disconnect(peer, 0);
+	run_server(10);
+	enet_host_destroy(clients);
+}
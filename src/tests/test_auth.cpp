@@ -68,9 +68,57 @@ static void auth_friends_test(DatabaseAuth &db)
 		db.listFriends("Wilson", &friends);
 		CHECK(friends.size() == 1);
 		CHECK(friends[0].p1.status == 420);
+
+		// Cached list must be invalidated
+		CHECK(db.removeFriend("Terry", "Wilson"));
+		db.listFriends("Wilson", &friends);
+		CHECK(friends.empty());
+		db.listFriends("Terry", &friends);
+		CHECK(friends.size() == 1);
 	}
 }
 
+static void auth_cache_test(DatabaseAuth &db)
+{
+	AuthAccount auth;
+	auth.name = "Cached";
+	auth.level = AuthAccount::AL_REGISTERED;
+	CHECK(db.save(auth));
+
+	auto stats = db.getCacheStats();
+	AuthAccount out;
+	CHECK(db.load("Cached", &out));
+	CHECK(out.level == AuthAccount::AL_REGISTERED);
+	CHECK(db.getCacheStats().accounts.hits == stats.accounts.hits + 1);
+
+	// Write-through
+	CHECK(db.setPassword("Cached", "secret"));
+	CHECK(db.load("Cached", &out));
+	CHECK(out.password == "secret");
+	CHECK(!db.load("Nobody", &out));
+
+	// Negative ban lookup, then a new ban
+	stats = db.getCacheStats();
+	CHECK(!db.getBanRecord("Cached", "test", nullptr));
+	CHECK(!db.getBanRecord("Cached", "test", nullptr));
+	CHECK(db.getCacheStats().bans.hits == stats.bans.hits + 1);
+
+	AuthBanEntry ban;
+	ban.affected = "Cached";
+	ban.context = "test";
+	ban.expiry = time(nullptr) + 100;
+	CHECK(db.ban(ban));
+	ban.expiry += 100;
+	CHECK(db.ban(ban));
+
+	AuthBanEntry found;
+	CHECK(db.getBanRecord("Cached", "test", &found));
+	CHECK(found.expiry == ban.expiry);
+	found = AuthBanEntry();
+	CHECK(db.getBanRecord("Cached", "test", &found)); // cached
+	CHECK(found.expiry == ban.expiry);
+}
+
 static void auth_database_test()
 {
 	const char *filepath = "unittest_auth.sqlite3";
@@ -116,6 +164,7 @@ static void auth_database_test()
 	}
 
 	auth_friends_test(db);
+	auth_cache_test(db);
 
 	db.close();
 
@@ -0,0 +1,117 @@
+#if BUILD_CLIENT
+
+#include "unittest_internal.h"
+#include "client/client.h"
+#include "client/gameevent.h"
+#include "core/network_enums.h"
+#include "core/packet.h"
+
+struct EventRecorder : public GameEventHandler {
+	bool OnEvent(GameEvent &e) override
+	{
+		if (e.type_c2g == GameEvent::C2G_DIALOG)
+			texts.push_back(*e.text);
+		if (e.type_c2g == GameEvent::C2G_PLAYER_CHAT)
+			texts.push_back("chat:" + e.player_chat->message);
+		return true;
+	}
+
+	std::vector<std::string> texts;
+};
+
+static Packet make_message(const char *text)
+{
+	Packet pkt;
+	pkt.write(Packet2Client::Message);
+	pkt.writeStr16(text);
+	return pkt;
+}
+
+static Packet make_bulk(u16 seq, const Packet &inner)
+{
+	Packet pkt;
+	pkt.write(Packet2Client::Bulk);
+	pkt.write<u16>(seq);
+	pkt.writeRaw(inner.data(), inner.size());
+	return pkt;
+}
+
+static void test_bulk_order()
+{
+	EventRecorder recorder;
+	ClientStartData init;
+	Client cli(init);
+	cli.setEventTarget(&recorder);
+
+	// The barrier overtakes both bulk packets
+	Packet barrier;
+	barrier.write(Packet2Client::BulkBarrier);
+	barrier.write<u16>(2);
+	cli.processPacket(0, barrier);
+
+	Packet pkt_a = make_message("A");
+	cli.processPacket(0, pkt_a); // independent of the world
+	CHECK(recorder.texts.size() == 1);
+
+	Packet bulk_1 = make_bulk(1, make_message("1"));
+	cli.processPacket(0, bulk_1);
+	CHECK(recorder.texts.size() == 2);
+
+	Packet bulk_2 = make_bulk(2, make_message("2"));
+	cli.processPacket(0, bulk_2);
+
+	CHECK(recorder.texts.size() == 3);
+	CHECK(recorder.texts[0] == "A");
+	CHECK(recorder.texts[1] == "1");
+	CHECK(recorder.texts[2] == "2");
+
+	// While streaming chunks: only block data waits
+	cli.setStateForTest(ClientState::WorldPlay);
+	recorder.texts.clear();
+
+	Packet barrier_4;
+	barrier_4.write(Packet2Client::BulkBarrier);
+	barrier_4.write<u16>(4);
+	cli.processPacket(0, barrier_4);
+
+	Packet place;
+	place.write(Packet2Client::PlaceBlock);
+	cli.processPacket(0, place);
+	CHECK(cli.getBulkHeldCount() == 1);
+
+	Packet chat;
+	chat.write(Packet2Client::Chat);
+	chat.write<peer_t>(0); // SYSTEM
+	chat.writeStr16("C");
+	cli.processPacket(0, chat);
+	CHECK(recorder.texts.size() == 1);
+	CHECK(recorder.texts[0] == "chat:C");
+
+	// Bulk payloads are never held, regardless of their type
+	Packet bulk_3 = make_bulk(3, place);
+	cli.processPacket(0, bulk_3);
+	CHECK(cli.getBulkHeldCount() == 1);
+	Packet bulk_4 = make_bulk(4, make_message("4"));
+	cli.processPacket(0, bulk_4);
+	CHECK(cli.getBulkHeldCount() == 0);
+	CHECK(recorder.texts.size() == 2);
+	CHECK(recorder.texts[1] == "4");
+
+	cli.setEventTarget(nullptr);
+}
+
+void unittest_client()
+{
+	test_bulk_order();
+}
+
+#else // BUILD_CLIENT
+
+#include <stdio.h>
+
+void unittest_client()
+{
+	puts("Not implemented");
+}
+
+#endif
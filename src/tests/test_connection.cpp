@@ -1,6 +1,11 @@
 #include "unittest_internal.h"
 #include "core/connection.h"
+#include "core/network_enums.h"
 #include "core/packet.h"
+#include "server/server.h"
+#include <enet/enet.h>
+#include <atomic>
+#include <chrono>
 
 void sleep_ms(long delay);
 
@@ -15,7 +20,7 @@ public:
 	size_t last_size = 0;
 };
 
-void unittest_connection()
+static void test_send_receive()
 {
 	DummyProcessor proc;
 
@@ -62,3 +67,79 @@ void unittest_connection()
 		CHECK(proc.last_size == 2 + 4);
 	}
 }
+
+static void test_message_before_disconnect()
+{
+	// Small messages are bundled by the server. A disconnect must not
+	// discard the reason.
+	bool shutdown_requested = false;
+	Server server(&shutdown_requested);
+	CHECK(!shutdown_requested);
+
+	ENetHost *client = enet_host_create(nullptr, 1, 3, 0, 0);
+	CHECK(client);
+
+	ENetAddress address;
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = Connection::PORT_DEFAULT;
+	ENetPeer *peer = enet_host_connect(client, &address, 3, 0);
+
+	bool connected = false,
+		disconnected = false;
+	std::string message;
+
+	auto read_message = [&message] (Packet &pkt) {
+		if (pkt.read<Packet2Client>() == Packet2Client::Message)
+			message = pkt.readStr16();
+	};
+
+	for (int i = 0; i < 300 && !disconnected; ++i) {
+		ENetEvent event;
+		while (enet_host_service(client, &event, 10) > 0) {
+			if (event.type == ENET_EVENT_TYPE_CONNECT) {
+				connected = true;
+
+				// Valid name but not a guest account
+				Packet pkt;
+				pkt.write(Packet2Server::Hello);
+				pkt.write(PROTOCOL_VERSION_MAX);
+				pkt.write(PROTOCOL_VERSION_MIN);
+				pkt.writeStr16("GUESTabc");
+				pkt.write<u8>(0); // no audiovisuals
+				enet_peer_send(peer, 0, enet_packet_create(pkt.data(), pkt.size(),
+					ENET_PACKET_FLAG_RELIABLE));
+			} else if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+				Packet pkt(event.packet->data, event.packet->dataLength);
+				enet_packet_destroy(event.packet);
+
+				auto action = pkt.read<Packet2Client>();
+				if (action == Packet2Client::Bundle) {
+					while (pkt.getRemainingBytes() > 0) {
+						const uint8_t *data;
+						size_t len = pkt.readRawNoCopy(&data, pkt.read<u16>());
+						Packet inner(data, len);
+						read_message(inner);
+					}
+				} else if (action == Packet2Client::Message) {
+					message = pkt.readStr16();
+				}
+			} else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+				disconnected = true;
+				break;
+			}
+		}
+		server.step(server.tick_interval);
+	}
+
+	CHECK(connected);
+	CHECK(disconnected);
+	CHECK(message.find("naming scheme") != std::string::npos);
+
+	enet_host_destroy(client);
+}
+
+void unittest_connection()
+{
+	test_send_receive();
+	test_message_before_disconnect();
+}
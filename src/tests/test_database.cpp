@@ -2,6 +2,192 @@
 #include "core/world.h"
 #include "core/worldmeta.h"
 #include "server/database_world.h"
+#include "server/worldsaver.h"
+#include <set>
+#include <thread>
+
+static void test_chunked_storage(DatabaseWorld &db)
+{
+	World world(g_blockmanager, "chunked");
+	world.createEmpty({100, 40});
+	world.getMeta().owner = "test";
+
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(1, 2);
+	CHECK(bu.set(9));
+	CHECK(world.updateBlock(bu));
+	bu.pos = blockpos_t(90, 35);
+	CHECK(bu.set(502));
+	CHECK(world.updateBlock(bu));
+	CHECK(db.save(&world));
+
+	auto check_block = [] (const World &w, blockpos_t pos, bid_t id, bid_t bg) {
+		Block b;
+		CHECK(w.getBlock(pos, &b));
+		CHECK(b.id == id);
+		CHECK(b.bg == bg);
+	};
+
+	{
+		World loaded(g_blockmanager, "chunked");
+		CHECK(db.load(&loaded));
+		CHECK(loaded.getSize() == blockpos_t(100, 40));
+		check_block(loaded, {1, 2}, 9, 0);
+		check_block(loaded, {90, 35}, 0, 502);
+		CHECK(loaded.getChunkCountUsed() == world.getChunkCountUsed());
+	}
+
+	// Block changes in two chunks
+	bu.pos = blockpos_t(1, 2);
+	CHECK(bu.set(10));
+	CHECK(world.updateBlock(bu));
+	bu.pos = blockpos_t(90, 35);
+	CHECK(bu.setErase(true));
+	CHECK(world.updateBlock(bu));
+	CHECK(db.save(&world));
+
+	{
+		World loaded(g_blockmanager, "chunked");
+		CHECK(db.load(&loaded));
+		check_block(loaded, {1, 2}, 10, 0);
+		check_block(loaded, {90, 35}, 0, 0);
+		CHECK(loaded.getChunkCountUsed() == world.getChunkCountUsed());
+	}
+
+	// Every chunk changed: compressed in parallel
+	std::vector<blockpos_t> positions;
+	for (u16 y = 3; y < 40; y += WorldChunk::SIZE)
+	for (u16 x = 1; x < 100; x += WorldChunk::SIZE)
+		positions.emplace_back(x, y);
+	for (size_t i = 0; i < positions.size(); ++i) {
+		bu.pos = positions[i];
+		CHECK(bu.set(i % 2 ? 9 : 10));
+		CHECK(world.updateBlock(bu));
+	}
+	CHECK(world.getChunkCountUsed() == 8);
+	CHECK(db.save(&world));
+
+	{
+		World loaded(g_blockmanager, "chunked");
+		CHECK(db.load(&loaded));
+		for (size_t i = 0; i < positions.size(); ++i)
+			check_block(loaded, positions[i], i % 2 ? 9 : 10, 0);
+		check_block(loaded, {1, 2}, 10, 0);
+		CHECK(loaded.getChunkCountUsed() == world.getChunkCountUsed());
+	}
+
+	// Different size: chunk indices change
+	world.createEmpty({40, 70});
+	bu.pos = blockpos_t(35, 65);
+	CHECK(bu.set(9));
+	CHECK(world.updateBlock(bu));
+	CHECK(db.save(&world));
+
+	{
+		World loaded(g_blockmanager, "chunked");
+		CHECK(db.load(&loaded));
+		CHECK(loaded.getSize() == blockpos_t(40, 70));
+		check_block(loaded, {1, 2}, 0, 0);
+		check_block(loaded, {35, 65}, 9, 0);
+		CHECK(loaded.getChunkCountUsed() == world.getChunkCountUsed());
+	}
+
+	// Lobby queries without reading the world data
+	bool found = false;
+	for (const LobbyWorld &meta : db.getByPlayer("test"))
+		found |= meta.id == "chunked";
+	CHECK(found);
+	for (const LobbyWorld &meta : db.getFeatured())
+		CHECK(meta.id != "chunked"); // nearly empty
+}
+
+static void test_world_saver(DatabaseWorld &db, const char *filepath)
+{
+	WorldSaver saver;
+	CHECK(saver.tryOpen(filepath));
+
+	World w1(g_blockmanager, "saver_a");
+	w1.createEmpty({4, 3});
+	World w2(g_blockmanager, "saver_b");
+	w2.createEmpty({6, 2});
+
+	saver.enqueue(&w1, 1);
+	w1.getMeta().title = "newer";
+	saver.enqueue(&w1, 2); // likely merged
+	saver.enqueue(&w2);
+
+	std::set<peer_t> peers_a;
+	bool done_b = false;
+	for (int i = 0; i < 500 && (peers_a.size() < 2 || !done_b); ++i) {
+		WorldSaver::Result res;
+		if (!saver.popResult(res)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		CHECK(res.ok);
+		if (res.world_id == "saver_a")
+			peers_a.insert(res.peer_ids.begin(), res.peer_ids.end());
+		else if (res.world_id == "saver_b")
+			done_b = res.peer_ids.empty();
+	}
+	CHECK(peers_a == std::set<peer_t>({1, 2}));
+	CHECK(done_b);
+
+	{
+		// The latest snapshot is stored
+		World world(g_blockmanager, "saver_a");
+		CHECK(db.load(&world));
+		CHECK(world.getSize().X == 4);
+		CHECK(world.getMeta().title == "newer");
+	}
+
+	// Journal: applied edits that are not yet part of the world data
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(2, 1);
+	auto set_block = [&] (bid_t id) {
+		CHECK(bu.set(id));
+		CHECK(w1.updateBlock(bu));
+		saver.appendJournal("saver_a", bu);
+	};
+	auto load_block_id = [&db, &bu] (bool owner_save) -> bid_t {
+		World world(g_blockmanager, "saver_a");
+		CHECK(db.load(&world, owner_save));
+		Block b;
+		CHECK(world.getBlock(bu.pos, &b));
+		return b.id;
+	};
+
+	set_block(9);
+	CHECK(saver.needsCheckpoint("saver_a"));
+	CHECK(!saver.needsCheckpoint("saver_b"));
+	saver.wait("saver_a");
+	CHECK(load_block_id(false) == 9);
+	CHECK(load_block_id(true) == 0); // no /save yet: last checkpoint
+
+	// Owner save
+	saver.enqueue(&w1, 0, true);
+	CHECK(!saver.needsCheckpoint("saver_a"));
+	saver.wait();
+	CHECK(load_block_id(false) == 9);
+	CHECK(load_block_id(true) == 9);
+
+	// Checkpoints do not replace the owner save
+	set_block(10);
+	saver.enqueue(&w1);
+	saver.wait();
+	CHECK(load_block_id(false) == 10);
+	CHECK(load_block_id(true) == 9);
+
+	// ... also when merged with a pending owner save
+	set_block(11);
+	saver.enqueue(&w1, 0, true);
+	set_block(12);
+	saver.enqueue(&w1);
+	saver.wait();
+	CHECK(load_block_id(false) == 12);
+	CHECK(load_block_id(true) == 11);
+}
 
 void unittest_database()
 {
@@ -32,6 +218,10 @@ void unittest_database()
 		CHECK(!db.load(&world));
 	}
 
+	test_chunked_storage(db);
+
+	test_world_saver(db, filepath);
+
 	db.close();
 
 	std::remove(filepath);
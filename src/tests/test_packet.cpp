@@ -76,6 +76,20 @@ static void test_view_read_write()
 	CHECK(pkt.readStr16() == val_str);
 }
 
+static void test_move()
+{
+	// Containers relocate their elements
+	std::vector<Packet> packets;
+	for (int i = 0; i < 20; ++i) {
+		packets.emplace_back();
+		packets.back().write<uint16_t>(i);
+	}
+
+	Packet moved(std::move(packets[7]));
+	CHECK(moved.read<uint16_t>() == 7);
+	CHECK(packets[19].read<uint16_t>() == 19);
+}
+
 static void test_compressor()
 {
 	Packet pkt;
@@ -151,5 +165,6 @@ void unittest_packet()
 	test_repeated();
 	test_blockparams();
 	test_view_read_write();
+	test_move();
 	test_compressor();
 }
@@ -1,6 +1,9 @@
 #include "unittest_internal.h"
+#include "core/packet.h"
 #include "core/world.h"
 #include "server/remoteplayer.h"
+#include <cmath> // std::fabs
+#include <random>
 
 static bool fuzzy_check(core::vector2df a, core::vector2df b, float maxdiff = 0.1f)
 {
@@ -21,8 +24,105 @@ static void run_steps(Player &p, float dtime)
 	p.step(dtime);
 }
 
+static void test_compact_physics()
+{
+	RemotePlayer src(1, 14), dst(2, 14);
+	src.pos = { 12.5f, 3.25f };
+	src.vel = { 10.3f, -4.0f };
+	src.acc = { 0, Player::GRAVITY_NORMAL };
+	src.coins = 3;
+	PlayerControls ctrl;
+	ctrl.dir = { 1, -1 };
+	ctrl.jump = true;
+	src.setControls(ctrl);
+
+	Packet legacy;
+	legacy.data_version = 13;
+	src.writePhysics(legacy);
+
+	auto send = [&] () -> size_t {
+		Packet pkt;
+		pkt.data_version = 14;
+		src.writePhysics(pkt, src.updatePhysicsBaseline());
+		dst.readPhysics(pkt);
+		CHECK(pkt.getRemainingBytes() == 0);
+		return pkt.size();
+	};
+
+	// First packet contains everything
+	send();
+	CHECK(fuzzy_check(dst.pos, src.pos, 0.01f));
+	CHECK(fuzzy_check(dst.vel, src.vel, 0.01f));
+	CHECK(fuzzy_check(dst.acc, src.acc, 4.0f));
+	CHECK(dst.coins == 3);
+	CHECK(dst.getControls() == ctrl);
+
+	// Unchanged fields are omitted after a few repetitions
+	for (int i = 0; i < 3; ++i)
+		send();
+	src.pos.X += 0.5f;
+	size_t len = send();
+	CHECK(len * 5 <= legacy.size());
+	CHECK(fuzzy_check(dst.pos, src.pos, 0.01f));
+	CHECK(fuzzy_check(dst.vel, src.vel, 0.01f));
+	CHECK(dst.coins == 3);
+
+	// Moving player
+	src.vel.X = -20;
+	src.acc.X = -Player::CONTROLS_ACCEL;
+	len = send();
+	CHECK(len * 3 <= legacy.size());
+	CHECK(fuzzy_check(dst.vel, src.vel, 0.01f));
+	CHECK(fuzzy_check(dst.acc, src.acc, 4.0f));
+}
+
+static void test_compact_physics_loss()
+{
+	// Move packets are neither reliable nor acknowledged. Measure how often
+	// a receiver is left with outdated velocity, acceleration or state.
+	std::mt19937 rng(42);
+	for (int loss_percent : { 5, 20 }) {
+		RemotePlayer src(1, 14), dst(2, 14);
+		size_t delivered = 0, stale = 0, stale_run = 0, stale_run_max = 0;
+
+		for (int i = 0; i < 20000; ++i) {
+			// About one change per 5 packets
+			switch (rng() % 15) {
+				case 0: src.vel.X = (int)(rng() % 40) - 20.0f; break;
+				case 1: src.acc.Y = (rng() % 2) ? Player::GRAVITY_NORMAL : 0; break;
+				case 2: src.coins++; break;
+			}
+
+			Packet pkt;
+			pkt.data_version = 14;
+			src.writePhysics(pkt, src.updatePhysicsBaseline());
+			if ((int)(rng() % 100) < loss_percent)
+				continue;
+
+			dst.readPhysics(pkt);
+			delivered++;
+
+			const bool is_stale = (dst.vel - src.vel).getLengthSQ() > 0.01f * 0.01f
+				|| std::fabs(dst.acc.Y - src.acc.Y) > 2.01f
+				|| dst.coins != src.coins;
+			stale += is_stale;
+			stale_run = is_stale ? stale_run + 1 : 0;
+			stale_run_max = std::max(stale_run_max, stale_run);
+		}
+
+		printf("Move packet loss %d%%: %.3f%% stale, at most %zu in a row\n",
+			loss_percent, stale * 100.0f / delivered, stale_run_max);
+		// Bounded by the keyframe interval (16), unless a keyframe is lost
+		CHECK(stale_run_max < 2 * 16);
+		CHECK(stale * 100 < delivered);
+	}
+}
+
 void unittest_physics()
 {
+	test_compact_physics();
+	test_compact_physics_loss();
+
 	// Run physics simulations to check whether the player movement works as expected
 
 	Block b_left(1);
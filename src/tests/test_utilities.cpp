@@ -1,5 +1,8 @@
 #include "unittest_internal.h"
+#include "core/lrucache.h"
+#include "core/mpscqueue.h"
 #include "core/playerflags.h"
+#include "core/threadpool.h"
 #include "core/timer.h"
 #include "core/utils.h"
 
@@ -97,6 +100,91 @@ static void test_rate_limit()
 	CHECK(rl.isActive());
 }
 
+static void test_threadpool()
+{
+	ThreadPool pool(3);
+	CHECK(pool.getThreadCount() == 3);
+
+	std::vector<int> results(100, 0);
+	pool.run(results.size(), [&] (size_t i) {
+		results[i] = i * 2;
+	});
+	for (size_t i = 0; i < results.size(); ++i)
+		CHECK(results[i] == (int)i * 2);
+
+	// Exceptions are forwarded to the caller
+	bool thrown = false;
+	try {
+		pool.run(10, [] (size_t i) {
+			if (i == 7)
+				throw std::runtime_error("dummy");
+		});
+	} catch (std::runtime_error &e) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+static void test_mpscqueue()
+{
+	constexpr int PRODUCERS = 4;
+	constexpr int PER_PRODUCER = 20000;
+
+	MPSCQueue<std::unique_ptr<int>> queue;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < PRODUCERS; ++t) {
+		threads.emplace_back([&queue, t] {
+			for (int i = 0; i < PER_PRODUCER; ++i)
+				queue.push(std::make_unique<int>(t * PER_PRODUCER + i));
+		});
+	}
+
+	// Consume concurrently. The order per producer must be kept.
+	std::vector<int> last(PRODUCERS, -1);
+	int count = 0;
+	std::unique_ptr<int> v;
+	while (count < PRODUCERS * PER_PRODUCER) {
+		if (!queue.pop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+		const int t = *v / PER_PRODUCER;
+		CHECK(*v % PER_PRODUCER == last[t] + 1);
+		last[t] = *v % PER_PRODUCER;
+		count++;
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+	CHECK(!queue.pop(v));
+	for (int i : last)
+		CHECK(i == PER_PRODUCER - 1);
+
+	// Leftovers are freed by the destructor
+	queue.push(std::make_unique<int>(42));
+}
+
+static void test_lrucache()
+{
+	LRUCache<int, std::string> cache(2);
+	cache.set(1, "one");
+	cache.set(2, "two");
+	CHECK(cache.get(1) && *cache.get(1) == "one");
+	cache.set(3, "three"); // evicts 2
+	CHECK(!cache.get(2));
+	CHECK(cache.get(1) && cache.get(3));
+	CHECK(cache.size() == 2);
+
+	cache.set(1, "uno"); // overwrite
+	CHECK(*cache.get(1) == "uno");
+	cache.erase(1);
+	CHECK(!cache.get(1));
+	CHECK(cache.size() == 1);
+
+	CHECK(cache.hits == 5);
+	CHECK(cache.misses == 2);
+}
+
 void unittest_utilities()
 {
 	const std::string utf8_in1 = "Hello Wörld!";
@@ -118,6 +206,9 @@ void unittest_utilities()
 
 	do_lifetime_test(LifetimeTest().get());
 	test_playerflags();
+	test_threadpool();
+	test_mpscqueue();
+	test_lrucache();
 	test_timer();
 	test_rate_limit();
 }
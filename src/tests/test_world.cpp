@@ -1,7 +1,13 @@
 #include "unittest_internal.h"
+#include "core/blockscan.h"
+#include "core/compressor.h"
+#include "core/eeo_converter.h"
 #include "core/operators.h" // PositionRange
 #include "core/packet.h"
 #include "core/world.h"
+#include "core/worldmeta.h" // LobbyWorld
+#include <chrono>
+#include <map>
 
 static void test_get_set_update(World &w)
 {
@@ -76,6 +82,618 @@ static void test_readwrite(World &w)
 	CHECK(b.bg == 502);
 }
 
+static bool worlds_equal(const World &a, const World &b)
+{
+	const blockpos_t size = a.getSize();
+	if (size != b.getSize())
+		return false;
+
+	for (u16 y = 0; y < size.Y; ++y)
+	for (u16 x = 0; x < size.X; ++x) {
+		Block ba, bb;
+		a.getBlock({x, y}, &ba);
+		b.getBlock({x, y}, &bb);
+		if (ba.id != bb.id || ba.bg != bb.bg)
+			return false;
+
+		BlockParams pa, pb;
+		if (a.getParams({x, y}, &pa) != b.getParams({x, y}, &pb))
+			return false;
+		if (!(pa == pb))
+			return false;
+	}
+	return true;
+}
+
+static void test_readwrite_v1(World &w)
+{
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(1, 3);
+	CHECK(bu.set(Block::ID_COINDOOR));
+	bu.params.param_u8 = 42;
+	CHECK(w.updateBlock(bu));
+
+	for (u16 proto : { (u16)11, PROTOCOL_VERSION_FAKE_DISK }) {
+		Packet out;
+		out.data_version = proto;
+		w.write(out, World::Method::CompressionV1);
+
+		World w2(g_blockmanager, "foobar_check_v1");
+		w2.createEmpty(w.getSize());
+		w2.setBlock({0, 0}, Block(9)); // must be overwritten
+		w2.read(out);
+		CHECK(worlds_equal(w, w2));
+
+		BlockParams params;
+		CHECK(w2.getParams(bu.pos, &params));
+		CHECK(params.param_u8 == 42);
+	}
+}
+
+static void test_read_legacy_bands()
+{
+	// Plain version 6 is no longer written but may still exist on disk.
+	// Hand-written: disk params mapper, then one zlib stream per row band.
+	const blockpos_t size(100, WorldChunk::SIZE * 2 + 5);
+	const u16 band_height = WorldChunk::SIZE;
+	const size_t n_bands = (size.Y + band_height - 1) / band_height;
+
+	Packet out;
+	out.data_version = PROTOCOL_VERSION_FAKE_DISK;
+	out.write<u32>(0x6677454F); // signature
+	out.write((u8)World::Method::Plain);
+	out.write<u8>(6); // version
+	out.write<u16>(band_height);
+	out.write<u16>(1 + n_bands);
+
+	auto write_stream = [&out] (Packet &raw) {
+		Packet compressed;
+		Compressor c(&compressed, raw);
+		c.compress();
+		out.write<u32>(compressed.size());
+		out.writeRaw(compressed.data(), compressed.size());
+	};
+
+	{
+		Packet mapper;
+		mapper.write<bid_t>(0); // terminator: no params
+		write_stream(mapper);
+	}
+	for (size_t i = 0; i < n_bands; ++i) {
+		Packet rows;
+		const size_t y0 = i * band_height;
+		for (size_t y = y0; y < std::min<size_t>(y0 + band_height, size.Y); ++y)
+		for (size_t x = 0; x < size.X; ++x) {
+			rows.write<bid_t>(x == y ? Block::ID_COIN : 0);
+			rows.write<bid_t>(0);
+		}
+		write_stream(rows);
+	}
+	out.write<u16>(0x4B4F); // validation
+
+	World w(g_blockmanager, "foobar_bands");
+	w.createEmpty(size);
+	w.read(out);
+
+	Block b;
+	CHECK(w.getBlock(blockpos_t(3, 3), &b));
+	CHECK(b.id == Block::ID_COIN);
+	CHECK(w.getBlock(blockpos_t(5, 4), &b));
+	CHECK(b.id == 0);
+	CHECK(w.getBlock(blockpos_t(68, 68), &b)); // last band
+	CHECK(b.id == Block::ID_COIN);
+}
+
+static void test_chunk_delta()
+{
+	World w(g_blockmanager, "foobar_delta");
+	w.createDummy({WorldChunk::SIZE * 4 + 7, WorldChunk::SIZE * 3});
+
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(3, 3);
+	CHECK(bu.set(Block::ID_COINDOOR));
+	bu.params.param_u8 = 10;
+	CHECK(w.updateBlock(bu));
+
+	// Client-side copy
+	World w2(g_blockmanager, "foobar_delta");
+	{
+		Packet out;
+		out.data_version = 12;
+		w.write(out, World::Method::CompressionV1);
+		w2.createEmpty(w.getSize());
+		w2.read(out);
+	}
+	CHECK(w.getChunkHashes() == w2.getChunkHashes());
+
+	// Tiles are ignored
+	w2.setBlock({0, 0}, Block(9));
+	Block b;
+	CHECK(w2.getBlock({0, 0}, &b));
+	b.tile = 1;
+	w2.setBlock({0, 0}, b);
+
+	// Modifications: params, blocks, air in the edge chunk
+	bu.params.param_u8 = 20;
+	CHECK(w.updateBlock(bu));
+	bu.pos = blockpos_t(WorldChunk::SIZE * 4 + 6, WorldChunk::SIZE * 3 - 1);
+	CHECK(bu.setErase(false));
+	CHECK(w.updateBlock(bu));
+	w2.setBlock({0, 0}, Block(9));
+
+	auto hashes = w.getChunkHashes();
+	auto cached = w2.getChunkHashes();
+	CHECK(hashes.size() == cached.size());
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < hashes.size(); ++i) {
+		if (hashes[i] != cached[i])
+			changed.push_back(i);
+	}
+	CHECK(changed.size() == 2);
+
+	Packet out;
+	out.data_version = 12;
+	w.writeChunks(out, changed);
+	w2.readChunks(out);
+	CHECK(worlds_equal(w, w2));
+	CHECK(w.getChunkHashes() == w2.getChunkHashes());
+	CHECK(w2.getBlocks(Block::ID_COINDOOR, nullptr).size() == 1);
+}
+
+static void test_chunk_stream()
+{
+	World w(g_blockmanager, "foobar_stream");
+	w.createDummy({WorldChunk::SIZE * 6 + 1, WorldChunk::SIZE * 4});
+	CHECK(w.setBlock({WorldChunk::SIZE * 6, 0}, Block(Block::ID_SPAWN)));
+
+	// Nearest first
+	const blockpos_t spawn(WorldChunk::SIZE * 5, WorldChunk::SIZE * 3);
+	auto chunks = w.getChunksUsedNear(spawn);
+	CHECK(chunks.size() == w.getChunkCountUsed());
+	CHECK(chunks[0] == 3 * 7 + 5);
+
+	// Apply in small packets, as sent by the server
+	World w2(g_blockmanager, "foobar_stream");
+	w2.createEmpty(w.getSize());
+	for (size_t i = 0; i < chunks.size(); i += 3) {
+		std::vector<size_t> part(chunks.begin() + i,
+			chunks.begin() + std::min(i + 3, chunks.size()));
+		Packet out;
+		out.data_version = 13;
+		w.writeChunks(out, part);
+		w2.readChunks(out);
+	}
+	CHECK(worlds_equal(w, w2));
+	CHECK(w2.getBlocks(Block::ID_SPAWN, nullptr).size() == 1);
+}
+
+static void test_snapshot()
+{
+	World w(g_blockmanager, "foobar_snapshot");
+	w.createDummy({1000, 700});
+
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(5, 600);
+	CHECK(bu.set(Block::ID_COINDOOR));
+	bu.params.param_u8 = 10;
+	CHECK(w.updateBlock(bu));
+
+	unittest_tic();
+	auto snapshot = w.createSnapshot();
+	unittest_toc("World snapshot");
+
+	// Modifications after the snapshot
+	bu.params.param_u8 = 20;
+	CHECK(w.updateBlock(bu));
+	CHECK(w.setBlock({1, 650}, Block(Block::ID_COIN)));
+	w.forEachBlock([] (blockpos_t pos, Block &b) {
+		if (pos.Y == 699)
+			b.bg = 502;
+	});
+
+	Block b;
+	CHECK(snapshot->getBlock({1, 650}, &b) && b.id == 9);
+	CHECK(snapshot->getBlock({1, 699}, &b) && b.bg == 0);
+	CHECK(w.getBlock({1, 699}, &b) && b.bg == 502);
+	BlockParams params;
+	CHECK(snapshot->getParams(bu.pos, &params) && params.param_u8 == 10);
+
+	// Serialization is independent of the source world
+	Packet out;
+	out.data_version = PROTOCOL_VERSION_FAKE_DISK;
+	unittest_tic();
+	snapshot->write(out, World::Method::Plain);
+	unittest_toc("World snapshot write");
+
+	World w2(g_blockmanager, "foobar_snapshot2");
+	w2.createEmpty(w.getSize());
+	w2.read(out);
+	CHECK(worlds_equal(*snapshot, w2));
+	CHECK(!worlds_equal(w, w2));
+}
+
+static void test_block_index()
+{
+	World w(g_blockmanager, "foobar_index");
+	w.createEmpty({300, 200});
+	CHECK(w.isBlockIndexed(Block::ID_SPAWN));
+	CHECK(!w.isBlockIndexed(9));
+
+	w.setBlock({250, 150}, Block(Block::ID_SPAWN));
+	w.setBlock({10, 150}, Block(Block::ID_SPAWN));
+	w.setBlock({20, 5}, Block(Block::ID_SPAWN));
+	w.setBlock({20, 5}, Block(Block::ID_SPAWN)); // no duplicate
+
+	// Row-major order
+	auto found = w.getBlocks(Block::ID_SPAWN, nullptr);
+	CHECK(found.size() == 3);
+	CHECK(found[0] == blockpos_t(20, 5));
+	CHECK(found[1] == blockpos_t(10, 150));
+
+	// Replaced by another block
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(10, 150);
+	CHECK(bu.set(Block::ID_TIMED_GATE_1));
+	CHECK(w.updateBlock(bu));
+	found = w.getBlocks(Block::ID_SPAWN, nullptr);
+	CHECK(found.size() == 2 && found[1] == blockpos_t(250, 150));
+
+	// Tiles of indexed blocks
+	PositionRange range;
+	range.type = PositionRange::PRT_ENTIRE_WORLD;
+	range.op = PositionRange::PROP_SET;
+	unittest_tic();
+	CHECK(w.setBlockTiles(range, Block::ID_TIMED_GATE_1, 4));
+	unittest_toc("setBlockTiles indexed");
+	Block b;
+	CHECK(w.getBlock(bu.pos, &b) && b.tile == 4);
+	CHECK(!w.setBlockTiles(range, Block::ID_TIMED_GATE_2, 4));
+
+	// Rebuilt after reading
+	Packet out;
+	out.data_version = PROTOCOL_VERSION_FAKE_DISK;
+	w.write(out, World::Method::Plain);
+	World w2(g_blockmanager, "foobar_index2");
+	w2.createEmpty(w.getSize());
+	w2.read(out);
+	CHECK(w2.getBlocks(Block::ID_SPAWN, nullptr) == w.getBlocks(Block::ID_SPAWN, nullptr));
+	CHECK(w2.getBlocks(Block::ID_TIMED_GATE_1, nullptr).size() == 1);
+}
+
+static void test_params_map()
+{
+	// Compare against the reference implementation
+	BlockParamsMap map;
+	std::map<blockpos_t, u8> ref;
+
+	u32 rng = 12345;
+	auto next_pos = [&rng] () {
+		rng = rng * 1103515245 + 12345;
+		return blockpos_t((rng >> 8) % 64, (rng >> 20) % 64);
+	};
+
+	BlockParams params(BlockParams::Type::U8);
+	for (int i = 0; i < 20000; ++i) {
+		blockpos_t pos = next_pos();
+		if (i % 3 == 2) {
+			CHECK(map.erase(pos) == (ref.erase(pos) > 0));
+		} else {
+			params.param_u8 = i;
+			map.set(pos, params);
+			ref[pos] = i;
+		}
+	}
+
+	CHECK(map.size() == ref.size());
+	for (u16 y = 0; y < 64; ++y)
+	for (u16 x = 0; x < 64; ++x) {
+		auto it = ref.find({x, y});
+		const BlockParams *found = map.find({x, y});
+		CHECK((it != ref.end()) == (found != nullptr));
+		if (found)
+			CHECK(found->param_u8 == it->second);
+	}
+
+	size_t count = 0;
+	for (const auto &entry : map) {
+		CHECK(ref.count(entry.pos) == 1);
+		count++;
+	}
+	CHECK(count == ref.size());
+
+	map.clear();
+	CHECK(map.empty() && !map.find({1, 1}));
+}
+
+static void benchmark_params_map()
+{
+	// Typical busy world: text signs, coin doors, teleporters
+	constexpr u16 SIZE = 400;
+	std::vector<blockpos_t> positions;
+	for (u16 y = 0; y < SIZE; y += 3)
+	for (u16 x = 0; x < SIZE; x += 5)
+		positions.emplace_back(x, y);
+
+	BlockParams params(BlockParams::Type::Text);
+	*params.text = "Hello world";
+
+	std::map<blockpos_t, BlockParams> map_old;
+	BlockParamsMap map_new;
+	for (blockpos_t pos : positions) {
+		map_old.emplace(pos, params);
+		map_new.set(pos, params);
+	}
+
+	// Lookups of all positions (hit or miss) like during world serialization
+	size_t hits = 0;
+	unittest_tic();
+	for (u16 y = 0; y < SIZE; ++y)
+	for (u16 x = 0; x < SIZE; ++x)
+		hits += map_old.find({x, y}) != map_old.end();
+	unittest_toc("params std::map lookup");
+	CHECK(hits == positions.size());
+
+	hits = 0;
+	unittest_tic();
+	for (u16 y = 0; y < SIZE; ++y)
+	for (u16 x = 0; x < SIZE; ++x)
+		hits += map_new.find({x, y}) != nullptr;
+	unittest_toc("params BlockParamsMap lookup");
+	CHECK(hits == positions.size());
+
+	size_t length = 0;
+	unittest_tic();
+	for (const auto &it : map_old)
+		length += it.second.text->size();
+	unittest_toc("params std::map iterate");
+
+	unittest_tic();
+	for (const auto &entry : map_new)
+		length -= entry.params.text->size();
+	unittest_toc("params BlockParamsMap iterate");
+	CHECK(length == 0);
+}
+
+static const BlockScanImpl BLOCKSCAN_IMPLS[] = {
+	BlockScanImpl::Scalar, BlockScanImpl::SSE2, BlockScanImpl::AVX2
+};
+
+static void test_blockscan()
+{
+	// Odd length to cover the scalar tail
+	std::vector<Block> ref(1000 + 3);
+	for (size_t i = 0; i < ref.size(); ++i) {
+		Block &b = ref[i];
+		b.id = (i * 7) % 5 == 0 ? Block::ID_COIN : (i % 3) + 9;
+		b.tile = i % 4;
+		b.bg = i % 7 == 0 ? 500 : 0;
+	}
+	// Same lower bits as ID_COIN in the background or tile
+	ref[1].bg = Block::ID_COIN;
+	ref.back().id = Block::ID_COIN;
+
+	std::vector<u16> idx_ref(ref.size());
+	size_t n_ref = blockscan_find_id(ref.data(), ref.size(), Block::ID_COIN,
+		idx_ref.data(), BlockScanImpl::Scalar);
+	CHECK(n_ref > 100);
+	CHECK(idx_ref[n_ref - 1] == ref.size() - 1);
+
+	for (BlockScanImpl impl : BLOCKSCAN_IMPLS) {
+		if (!blockscan_supported(impl))
+			continue;
+
+		std::vector<u16> idx(ref.size());
+		size_t n = blockscan_find_id(ref.data(), ref.size(), Block::ID_COIN, idx.data(), impl);
+		CHECK(n == n_ref);
+		CHECK(std::equal(idx.begin(), idx.begin() + n, idx_ref.begin()));
+		CHECK(blockscan_find_id(ref.data(), ref.size(), Block::ID_COIN, nullptr, impl) == n_ref);
+
+		std::vector<Block> blocks = ref;
+		CHECK(blockscan_set_tile(blocks.data(), blocks.size(), Block::ID_COIN, 13, impl) == n_ref);
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			const Block &a = blocks[i];
+			const Block &b = ref[i];
+			CHECK(a.id == b.id && a.bg == b.bg);
+			CHECK(a.tile == (b.id == Block::ID_COIN ? 13 : b.tile));
+		}
+	}
+
+	// World integration (non-indexed ID)
+	World w(g_blockmanager, "foobar_blockscan");
+	w.createEmpty({WorldChunk::SIZE * 2 + 3, 40});
+	const blockpos_t positions[] = { {0, 0}, {WorldChunk::SIZE * 2 + 2, 0}, {5, 39} };
+	for (blockpos_t pos : positions)
+		CHECK(w.setBlock(pos, Block(9)));
+
+	auto found = w.getBlocks(9, nullptr);
+	CHECK(found.size() == 3);
+	CHECK(found[0] == positions[0] && found[1] == positions[1] && found[2] == positions[2]);
+
+	PositionRange range;
+	range.type = PositionRange::PRT_ENTIRE_WORLD;
+	range.op = PositionRange::Operator::PROP_SET;
+	w.dirty.consume(DirtyMap::DC_RENDER);
+	CHECK(w.setBlockTiles(range, 9, 2));
+	auto areas = w.dirty.consume(DirtyMap::DC_RENDER);
+	CHECK(!areas.empty());
+	for (const auto &area : areas) {
+		CHECK(area.LowerRightCorner.X < w.getSize().X);
+		CHECK(area.LowerRightCorner.Y < w.getSize().Y);
+	}
+	Block b;
+	CHECK(w.getBlock(positions[2], &b) && b.tile == 2);
+}
+
+static void benchmark_blockscan()
+{
+	// Equivalent of a 1000x1000 world, 1 % coins
+	std::vector<Block> blocks(1000 * 1000, Block(9));
+	for (size_t i = 0; i < blocks.size(); i += 100)
+		blocks[i].id = Block::ID_COIN;
+
+	std::vector<u16> indices(WorldChunk::SIZE * WorldChunk::SIZE);
+	const size_t chunk_len = indices.size();
+
+	for (BlockScanImpl impl : BLOCKSCAN_IMPLS) {
+		if (!blockscan_supported(impl))
+			continue;
+
+		for (int mode = 0; mode < 2; ++mode) {
+			size_t found = 0;
+			auto time_start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < blocks.size(); i += chunk_len) {
+				size_t len = std::min(chunk_len, blocks.size() - i);
+				if (mode == 0)
+					found += blockscan_find_id(&blocks[i], len, Block::ID_COIN, indices.data(), impl);
+				else
+					found += blockscan_set_tile(&blocks[i], len, Block::ID_COIN, 1, impl);
+			}
+			double dtime = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - time_start).count();
+			CHECK(found == blocks.size() / 100);
+
+			printf("[blockscan %s %s] %.1f Mblocks/s\n", blockscan_name(impl),
+				mode == 0 ? "find_id" : "set_tile", blocks.size() / dtime * 1E-6);
+		}
+	}
+}
+
+/// Compares CompressionV1 against Plain. Uses the imported worlds if available.
+static void benchmark_methods()
+{
+	std::vector<std::unique_ptr<World>> worlds;
+	{
+		// Typical world: border, ground and a few scattered blocks
+		auto w = std::make_unique<World>(g_blockmanager, "bench_generated");
+		w->createDummy({200, 200});
+		for (u16 i = 0; i < 200; ++i) {
+			w->setBlock({i, 0}, Block(9));
+			w->setBlock({0, i}, Block(9));
+			w->setBlock({(u16)((i * 37) % 200), (u16)((i * 13) % 100)}, Block(Block::ID_COIN));
+		}
+		worlds.emplace_back(std::move(w));
+	}
+
+	std::map<std::string, LobbyWorld> importable;
+	EEOconverter::listImportableWorlds(importable);
+	for (const auto &it : importable) {
+		auto w = std::make_unique<World>(g_blockmanager, it.second.id);
+		try {
+			EEOconverter conv(*w);
+			conv.fromFile(EEOconverter::findWorldPath(it.second.id));
+		} catch (std::exception &e) {
+			continue;
+		}
+		worlds.emplace_back(std::move(w));
+	}
+
+	for (const auto &w : worlds) {
+		printf("World '%s' (%dx%d)\n", w->getMeta().id.c_str(),
+			w->getSize().X, w->getSize().Y);
+
+		for (auto method : { World::Method::Plain, World::Method::CompressionV1 }) {
+			const char *name = method == World::Method::Plain ? "Plain" : "V1";
+			Packet out;
+			out.data_version = PROTOCOL_VERSION_FAKE_DISK;
+
+			char buf[50];
+			snprintf(buf, sizeof(buf), "%s write", name);
+			unittest_tic();
+			w->write(out, method);
+			unittest_toc(buf);
+
+			World w2(g_blockmanager, "bench_check");
+			w2.createEmpty(w->getSize());
+			snprintf(buf, sizeof(buf), "%s read", name);
+			unittest_tic();
+			w2.read(out);
+			unittest_toc(buf);
+
+			printf("\t%s: %zu bytes\n", name, out.size());
+			CHECK(worlds_equal(*w, w2));
+		}
+	}
+}
+
+static void test_dirtymap()
+{
+	DirtyMap dm;
+	dm.resize({100, 40});
+	CHECK(dm.isDirty(DirtyMap::DC_RENDER));
+	{
+		// Everything is marked after resizing
+		auto areas = dm.consume(DirtyMap::DC_RENDER);
+		CHECK(areas.size() == 1);
+		CHECK(areas[0] == core::rect<u16>(0, 0, 99, 39));
+		CHECK(!dm.isDirty(DirtyMap::DC_RENDER));
+	}
+	dm.consume(DirtyMap::DC_MINIMAP);
+	dm.consume(DirtyMap::DC_EVENTS);
+
+	// Opposite corners: two separate areas
+	dm.mark(blockpos_t(1, 1));
+	dm.mark(blockpos_t(99, 39));
+	dm.mark(blockpos_t(100, 0)); // out of range
+	{
+		auto areas = dm.consume(DirtyMap::DC_RENDER);
+		CHECK(areas.size() == 2);
+		CHECK(areas[0] == core::rect<u16>(0, 0, 15, 15));
+		CHECK(areas[1] == core::rect<u16>(96, 32, 99, 39));
+		CHECK(dm.consume(DirtyMap::DC_RENDER).empty());
+	}
+
+	// Independent consumers
+	CHECK(dm.isDirty(DirtyMap::DC_MINIMAP));
+	CHECK(dm.consume(DirtyMap::DC_MINIMAP).size() == 2);
+	CHECK(!dm.isDirty(DirtyMap::DC_MINIMAP));
+	CHECK(dm.isDirty(DirtyMap::DC_EVENTS));
+
+	// Vertical merging of equal spans
+	dm.consume(DirtyMap::DC_EVENTS);
+	dm.mark(core::rect<u16>(20, 5, 40, 35));
+	{
+		auto areas = dm.consume(DirtyMap::DC_EVENTS);
+		CHECK(areas.size() == 1);
+		CHECK(areas[0] == core::rect<u16>(16, 0, 47, 39));
+	}
+}
+
+static void test_block_update_queue()
+{
+	BlockUpdateQueue queue;
+	BlockUpdate bu(g_blockmanager);
+
+	bu.pos = blockpos_t(3, 4);
+	CHECK(bu.set(9));
+	queue.insert(bu);
+	bu.pos = blockpos_t(5, 1);
+	queue.insert(bu);
+	bu.pos = blockpos_t(3, 4);
+	CHECK(bu.set(502)); // background: separate entry
+	queue.insert(bu);
+	CHECK(queue.size() == 3);
+
+	// Last write wins, the position keeps its place in the queue
+	CHECK(bu.set(10));
+	queue.insert(bu);
+	CHECK(queue.size() == 3);
+
+	CHECK(queue.front().pos == blockpos_t(3, 4));
+	CHECK(queue.front().getId() == 10);
+	queue.pop_front();
+	CHECK(queue.front().pos == blockpos_t(5, 1));
+	queue.pop_front();
+	CHECK(queue.front().getId() == 502);
+	queue.pop_front();
+	CHECK(queue.empty());
+
+	// Re-inserting after flushing appends again
+	queue.insert(bu);
+	CHECK(queue.size() == 1);
+	queue.clear();
+	CHECK(queue.empty());
+}
+
 static void test_positionrange()
 {
 	World w(g_blockmanager, "foobar_range");
@@ -124,8 +742,10 @@ static void test_positionrange_world
 	range.minp = blockpos_t(0, 0);
 	range.maxp = blockpos_t(400, 400); // entire world
 
-	for (Block *b = w.begin(); b != w.end(); ++b)
-		*b = Block(100);
+	const blockpos_t size = w.getSize();
+	for (u16 y = 0; y < size.Y; ++y)
+	for (u16 x = 0; x < size.X; ++x)
+		w.setBlock({x, y}, Block(100));
 
 	Block b;
 	u8 tile = 0;
@@ -142,6 +762,64 @@ static void test_positionrange_world
 	CHECK(modified_1 && !modified_2);
 }
 
+static void test_chunks()
+{
+	World w(g_blockmanager, "foobar_chunks");
+	// Partial chunks at the right and bottom edges
+	w.createEmpty({WorldChunk::SIZE * 3 + 5, WorldChunk::SIZE + 1});
+	CHECK(w.getChunkCountUsed() == 0);
+
+	Block b;
+	CHECK(w.getBlock({WorldChunk::SIZE * 3 + 4, WorldChunk::SIZE}, &b));
+	CHECK(b.id == 0 && b.bg == 0);
+
+	// Allocation on demand
+	const blockpos_t pos_edge(WorldChunk::SIZE * 3 + 4, WorldChunk::SIZE);
+	CHECK(w.setBlock(pos_edge, Block(Block::ID_COIN)));
+	CHECK(w.setBlock({1, 1}, Block(Block::ID_COIN)));
+	CHECK(w.setBlock({2, 1}, Block(Block::ID_COIN)));
+	CHECK(w.getChunkCountUsed() == 2);
+
+	// Only the allocated chunks are visited
+	size_t count = 0;
+	w.forEachBlock([&] (blockpos_t pos, Block &b) {
+		CHECK(pos.X < w.getSize().X && pos.Y < w.getSize().Y);
+		count++;
+	});
+	CHECK(count == WorldChunk::SIZE * WorldChunk::SIZE + 5 * 1);
+
+	auto found = w.getBlocks(Block::ID_COIN, nullptr);
+	CHECK(found.size() == 3);
+	CHECK(found[0] == blockpos_t(1, 1) && found[2] == pos_edge);
+
+	// Chunks that become air are released
+	CHECK(w.setBlock({1, 1}, Block()));
+	CHECK(w.getChunkCountUsed() == 2);
+	BlockUpdate bu(g_blockmanager);
+	bu.pos = blockpos_t(2, 1);
+	CHECK(bu.setErase(false));
+	CHECK(w.updateBlock(bu));
+	CHECK(w.getChunkCountUsed() == 1);
+
+	// Background-only blocks keep the chunk alive
+	bu.pos = blockpos_t(3, 3);
+	CHECK(bu.set(502));
+	CHECK(w.updateBlock(bu));
+	CHECK(w.getChunkCountUsed() == 2);
+	CHECK(w.getBlock(bu.pos, &b) && b.bg == 502);
+
+	// Plain read/write round trip
+	Packet out;
+	out.data_version = PROTOCOL_VERSION_FAKE_DISK;
+	w.write(out, World::Method::Plain);
+
+	World w2(g_blockmanager, "foobar_chunks2");
+	w2.createEmpty(w.getSize());
+	w2.read(out);
+	CHECK(w2.getChunkCountUsed() == 2);
+	CHECK(w2.getBlock(pos_edge, &b) && b.id == Block::ID_COIN);
+}
+
 void unittest_world()
 {
 	World w(g_blockmanager, "foobar");
@@ -149,6 +827,20 @@ void unittest_world()
 
 	test_get_set_update(w);
 	test_readwrite(w);
+	test_readwrite_v1(w);
+	test_read_legacy_bands();
+	test_chunk_delta();
+	test_chunk_stream();
+	test_snapshot();
+	test_block_index();
+	test_params_map();
+	benchmark_params_map();
 	test_positionrange();
 	test_positionrange_world(w);
+	test_chunks();
+	test_blockscan();
+	benchmark_blockscan();
+	test_dirtymap();
+	test_block_update_queue();
+	benchmark_methods();
 }
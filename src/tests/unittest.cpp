@@ -3,6 +3,7 @@
 
 void unittest_auth();
 void unittest_chatcommand();
+void unittest_client();
 void unittest_connection();
 void unittest_eeo_converter();
 void unittest_database();
@@ -63,6 +64,7 @@ void unittest(int gui_test_nr)
 		unittest_sound();
 		unittest_irr();
 		unittest_gui_gameplay();
+		unittest_client(); // last: resets g_blockmanager
 
 		puts("<== Unittest completed");
 	}